@@ -0,0 +1,193 @@
+#include "apic.h"
+#include "lib.h"
+#include "page.h"
+#include "idt.h"
+#include "scheduling.h"
+
+// PIT channel 2 times the startup sequence and the timer calibration;
+// channel 0 isn't running yet. Its gate and output are bits of the
+// speaker port
+#define PIT_CH2_DATA_PORT   0x42
+#define PIT_CH2_MODE0       0xB0
+#define SPEAKER_PORT        0x61
+#define SPEAKER_GATE        0x01
+#define SPEAKER_ENABLE      0x02
+#define SPEAKER_OUT         0x20
+
+volatile uint32_t *lapic;
+uint32_t apic_timer_count;
+uint8_t ioapic_active;
+/* Mapped by apic_init if it answers */
+static volatile uint32_t *ioapic;
+
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    return ioapic[IOAPIC_WIN >> 2];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t val) {
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    ioapic[IOAPIC_WIN >> 2] = val;
+}
+
+/* Function: lapic_send
+ * Inputs: dest - APIC ID of the target, ignored for shorthands
+ *         icr - vector, delivery mode and shorthand
+ * Return Value: none
+ */
+void lapic_send(uint32_t dest, uint32_t icr) {
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING) {
+        asm volatile ("pause");
+    }
+    lapic_write(LAPIC_ICR_HI, dest << 24);
+    lapic_write(LAPIC_ICR_LO, icr);
+}
+
+/* Function: lapic_eoi
+ * Inputs: none
+ * Return Value: none
+ * Description: One write, whatever the interrupt came from; no port I/O
+ */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Function: apic_delay_us
+ * Inputs: us - microseconds, up to about 50000
+ * Return Value: none
+ * Description: Busy-waits on a one-shot count of PIT channel 2
+ */
+void apic_delay_us(uint32_t us) {
+    uint32_t count = us * (CLOCK_TICK_RATE / 1000) / 1000;
+    uint8_t gate = inb(SPEAKER_PORT) & ~(SPEAKER_GATE | SPEAKER_ENABLE);
+
+    outb(gate, SPEAKER_PORT);
+    outb(PIT_CH2_MODE0, PIT_CMD_REG);
+    outb(count & 0xFF, PIT_CH2_DATA_PORT);
+    outb(count >> 8, PIT_CH2_DATA_PORT);
+    // The count starts when the gate goes high
+    outb(gate | SPEAKER_GATE, SPEAKER_PORT);
+    while (!(inb(SPEAKER_PORT) & SPEAKER_OUT));
+    outb(gate, SPEAKER_PORT);
+}
+
+/* Function: lapic_init_cpu
+ * Inputs: cpu - the CPU running this
+ * Return Value: none
+ * Description: Software-enables this CPU's local APIC, so interrupts it
+ *              can't deliver go to the spurious vector, and leaves its
+ *              timer stopped until the CPU has a task to run
+ */
+void lapic_init_cpu(cpu_t *cpu) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_INT);
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_INT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    cpu->apic_id = lapic_read(LAPIC_ID) >> 24;
+    cpu->tick_state = PIT_STOPPED;
+}
+
+/* Function: lapic_timer_start
+ * Inputs: count - timer counts until the interrupt
+ *         periodic - 1 to reload and go again, 0 for a single interrupt
+ * Return Value: none
+ */
+void lapic_timer_start(uint32_t count, uint8_t periodic) {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_INT | (periodic ? LAPIC_TIMER_PERIODIC : 0));
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/* Function: lapic_timer_stop
+ * Inputs: none
+ * Return Value: none
+ */
+void lapic_timer_stop(void) {
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_INT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+}
+
+/* Function: lapic_timer_calibrate
+ * Inputs: none
+ * Return Value: how many times the timer counts in one scheduler tick
+ * Description: The timer runs off the bus clock, whose rate isn't known,
+ *              so it is counted against the PIT for one tick
+ */
+static uint32_t lapic_timer_calibrate(void) {
+    uint32_t left;
+
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    apic_delay_us(1000000 / PIT_HZ);
+    left = lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    return 0xFFFFFFFF - left;
+}
+
+/* Function: ioapic_route
+ * Inputs: irq - ISA IRQ number
+ *         apic_id - local APIC to deliver it to
+ *         masked - 1 to turn the line off
+ * Return Value: none
+ * Description: Edge triggered and active high, like every ISA line, on
+ *              the vector the 8259s would have used
+ */
+void ioapic_route(uint32_t irq, uint8_t apic_id, uint8_t masked) {
+    uint32_t pin = irq == PIT_IRQNUM ? IOAPIC_PIT_PIN : irq;
+
+    // Masked while the destination changes, so it can't fire half set up
+    ioapic_write(IOAPIC_REDTBL + 2 * pin, IOAPIC_MASKED | (PIT_INT + irq));
+    ioapic_write(IOAPIC_REDTBL + 2 * pin + 1, (uint32_t) apic_id << 24);
+    ioapic_write(IOAPIC_REDTBL + 2 * pin, (masked ? IOAPIC_MASKED : 0) | (PIT_INT + irq));
+}
+
+/* Function: ioapic_init
+ * Inputs: none
+ * Return Value: 0 if the I/O APIC is there, -1 if not
+ * Description: Masks every pin; enable_irq turns them on one at a time
+ */
+static int32_t ioapic_init(void) {
+    uint32_t ver, pins, i;
+
+    page_map_uncached(IOAPIC_BASE);
+    ioapic = (volatile uint32_t *) IOAPIC_BASE;
+    // Nothing there reads back as all ones
+    ver = ioapic_read(IOAPIC_VER);
+    pins = ((ver >> 16) & 0xFF) + 1;
+    if (ver == 0xFFFFFFFF || pins < PIC_IRQ_NUM) {
+        ioapic = NULL;
+        return -1;
+    }
+    for (i = 0; i < pins; i++) {
+        ioapic_write(IOAPIC_REDTBL + 2 * i, IOAPIC_MASKED);
+    }
+    ioapic_active = 1;
+    return 0;
+}
+
+/* Function: apic_init
+ * Inputs: none
+ * Return Value: 0 if there is a local APIC, -1 if not
+ * Description: Maps and enables the boot CPU's local APIC and measures its
+ *              timer, which takes over the tick from the PIT, then moves
+ *              the device interrupts over to the I/O APIC if there is one.
+ *              Without one they stay on the 8259s
+ */
+int32_t apic_init(void) {
+    uint32_t eax = 1, ebx, ecx, edx, lo, hi;
+
+    asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    if (!(edx & CPUID_APIC)) {
+        return -1;
+    }
+    asm volatile ("rdmsr" : "=a" (lo), "=d" (hi) : "c" (IA32_APIC_BASE_MSR));
+    page_map_uncached(lo & APIC_BASE_MASK);
+    lapic = (volatile uint32_t *) (lo & APIC_BASE_MASK);
+    lapic_init_cpu(this_cpu());
+
+#ifndef APIC_USE_8259
+    SET_IDT_ENTRY(idt[LAPIC_TIMER_INT], _lapic_timer_isr);
+    idt[LAPIC_TIMER_INT].present = 1;
+    apic_timer_count = lapic_timer_calibrate();
+    ioapic_init();
+#endif
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef _APIC_H
+#define _APIC_H
+
+/* Relevant citations and sources
+ * Intel SDM vol. 3A ch.10 (APIC)
+ * Intel 82093AA I/O APIC datasheet
+ * https://wiki.osdev.org/APIC_timer
+ */
+
+#include "types.h"
+
+// Define to leave device interrupts on the 8259s and the scheduler tick on
+// the PIT, with the local APICs only used for IPIs; kept for comparing
+// interrupt overhead
+/* #define APIC_USE_8259 */
+
+#define IA32_APIC_BASE_MSR  0x1B
+#define APIC_BASE_MASK      0xFFFFF000
+// CPUID leaf 1, EDX
+#define CPUID_APIC          (1 << 9)
+
+// Local APIC registers, as offsets from its base
+#define LAPIC_ID            0x020
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LO        0x300
+#define LAPIC_ICR_HI        0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CUR     0x390
+#define LAPIC_TIMER_DIV     0x3E0
+#define LAPIC_SVR_ENABLE    0x100
+// Interrupt command register fields
+#define LAPIC_ICR_INIT      0x00000500
+#define LAPIC_ICR_STARTUP   0x00000600
+#define LAPIC_ICR_PENDING   0x00001000
+#define LAPIC_ICR_ASSERT    0x00004000
+#define LAPIC_ICR_LEVEL     0x00008000
+#define LAPIC_ICR_OTHERS    0x000C0000
+// Local vector table fields
+#define LAPIC_LVT_MASKED    0x00010000
+#define LAPIC_TIMER_PERIODIC 0x00020000
+#define LAPIC_TIMER_DIV16   0x3
+
+// There is no MADT parsing, so the I/O APIC is assumed to be where every
+// PC chipset puts the first one
+#define IOAPIC_BASE         0xFEC00000
+#define IOAPIC_REGSEL       0x00
+#define IOAPIC_WIN          0x10
+#define IOAPIC_VER          0x01
+// Two registers per pin, low then high
+#define IOAPIC_REDTBL       0x10
+#define IOAPIC_MASKED       0x00010000
+// The PIT is on pin 2, not 0; the one interrupt source override nearly
+// every board's MADT has
+#define IOAPIC_PIT_PIN      2
+
+#ifndef ASM
+
+#include "smp.h"
+
+/* Mapped by apic_init; NULL if the CPU has no local APIC */
+extern volatile uint32_t *lapic;
+/* Local APIC timer counts per scheduler tick, or 0 if the PIT ticks */
+extern uint32_t apic_timer_count;
+/* Device interrupts come through the I/O APIC rather than the 8259s */
+extern uint8_t ioapic_active;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg >> 2];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    lapic[reg >> 2] = val;
+}
+
+int32_t apic_init(void);
+void lapic_init_cpu(cpu_t *cpu);
+void lapic_send(uint32_t dest, uint32_t icr);
+void lapic_eoi(void);
+void lapic_timer_start(uint32_t count, uint8_t periodic);
+void lapic_timer_stop(void);
+void ioapic_route(uint32_t irq, uint8_t apic_id, uint8_t masked);
+void apic_delay_us(uint32_t us);
+
+#endif /* ASM */
+
+#endif /* _APIC_H */
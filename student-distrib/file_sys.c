@@ -1,4 +1,5 @@
 #include "file_sys.h"
+#include "page_cache.h"
 #include "lib.h"
 
 // File ops table
@@ -20,16 +21,268 @@ file_ops_table_t fs_dir_ops_table = {
 static uint32_t bblock_ptr;
 static inode_t* inodes;
 static dentry_t* dentries;
+static uint32_t dentry_count;
+/* The boot block only has room for MAX_FILE_NUM dentries; the directory
+ * continues in this table once it outgrows the boot block */
+static dentry_t extra_dentries[FS_MAX_DENTRIES - MAX_FILE_NUM];
+
+/* Hash index over the dentry names. Each bucket is a chain of dentry
+ * indices linked through fs_hash_next; the full hash of every entry is
+ * kept so a lookup only falls back to strncmp on a real candidate */
+static uint16_t fs_hash_heads[FS_HASH_BUCKETS];
+static uint16_t fs_hash_next[FS_MAX_DENTRIES];
+static uint32_t fs_hash_vals[FS_MAX_DENTRIES];
+
+/* Writable mode state. A set bit in block_bitmap marks a data block in
+ * use; inode_bitmap does the same for inodes */
+static uint8_t fs_writable;
+static uint32_t data_block_capacity;
+static uint32_t block_bitmap[FS_MAX_DATA_BLOCKS / 32];
+static uint32_t inode_bitmap[FS_MAX_DENTRIES / 32];
+
+/* Number of live mmap regions over each inode. mmap hands out the data
+ * blocks themselves, so a mapped file must keep them */
+static uint16_t fs_map_count[FS_MAX_DENTRIES];
+
+static uint32_t fs_name_hash(const int8_t* fname);
+static dentry_t* fs_dentry(uint32_t index);
+static void fs_init_bitmaps(void);
 
 /* Function: fs_init;
  * Inputs: boot_ptr - the ptr the boot block
+ *         boot_end - the end of the loaded image
  * Return Value: None
- * Function: Initializes global variables
+ * Function: Initializes global variables. The image is writable when the
+ *           memory after it can hold at least one more data block
  */
-void fs_init(uint32_t boot_ptr){
+void fs_init(uint32_t boot_ptr, uint32_t boot_end){
+    uint32_t i;
+    uint32_t data_start;
+
     bblock_ptr = boot_ptr;
     dentries = (dentry_t*)(bblock_ptr + BBLOCK_DENTRIES_OFF);
     inodes = (inode_t*)(bblock_ptr + BLOCK_SIZE);
+    dentry_count = *((uint32_t*)bblock_ptr);
+    if(dentry_count > MAX_FILE_NUM)
+      dentry_count = MAX_FILE_NUM;
+
+    /* build the name index over every boot block dentry */
+    for(i = 0; i < FS_HASH_BUCKETS; i++)
+      fs_hash_heads[i] = FS_INDEX_NONE;
+    for(i = 0; i < dentry_count; i++)
+      (void)fs_index_insert(i);
+
+    /* everything between the image and the kernel stacks can hold new
+      data blocks */
+    data_start = bblock_ptr + (*((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)) + 1) * BLOCK_SIZE;
+    data_block_capacity = 0;
+    if(boot_end <= FS_WRITE_LIMIT && data_start < FS_WRITE_LIMIT)
+      data_block_capacity = (FS_WRITE_LIMIT - data_start) / BLOCK_SIZE;
+    if(data_block_capacity > FS_MAX_DATA_BLOCKS)
+      data_block_capacity = FS_MAX_DATA_BLOCKS;
+    fs_writable = data_block_capacity > *((uint32_t*)(bblock_ptr + BBLOCK_DATA_COUNT_OFF));
+    if(fs_writable)
+      fs_init_bitmaps();
+
+    page_cache_init();
+}
+
+/* Function: fs_init_bitmaps
+ * Inputs: None
+ * Return Value: None
+ * Function: Marks the inodes and data blocks used by the files in the
+ *           image, so the allocators only hand out free ones
+ */
+static void fs_init_bitmaps(void){
+    uint32_t i, j, blocks;
+    dentry_t* dent;
+    inode_t* inode;
+
+    memset(block_bitmap, 0, sizeof(block_bitmap));
+    memset(inode_bitmap, 0, sizeof(inode_bitmap));
+
+    for(i = 0; i < dentry_count; i++){
+      dent = fs_dentry(i);
+      if(dent->filetype != FILE_TYPE_REG)
+        continue;
+      if(dent->inode_num < FS_MAX_DENTRIES)
+        BITMAP_SET(inode_bitmap, dent->inode_num);
+      inode = &inodes[dent->inode_num];
+      blocks = (inode->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+      for(j = 0; j < blocks; j++){
+        if(inode->data_blocks[j] < data_block_capacity)
+          BITMAP_SET(block_bitmap, inode->data_blocks[j]);
+      }
+    }
+}
+
+/* Function: fs_alloc_block
+ * Inputs: hint - the block we would like to get, usually the one right
+ *                after the file's current last block
+ *         want - the number of blocks the caller still expects to need
+ * Return Value: the allocated block number, or -1 if the image is full
+ * Function: Allocates a data block, keeping files contiguous: the hint is
+ *           used when it is free, otherwise the first free run that can
+ *           hold `want' blocks, otherwise any free block
+ */
+static int32_t fs_alloc_block(uint32_t hint, uint32_t want){
+    uint32_t i, run_start = 0, run_len = 0;
+    int32_t any = -1;
+    uint32_t* data_block_count = (uint32_t*)(bblock_ptr + BBLOCK_DATA_COUNT_OFF);
+
+    if(hint >= data_block_capacity || BITMAP_TEST(block_bitmap, hint)){
+      hint = data_block_capacity;
+      for(i = 0; i < data_block_capacity; i++){
+        if(BITMAP_TEST(block_bitmap, i)){
+          run_len = 0;
+          continue;
+        }
+        if(!run_len++)
+          run_start = i;
+        if(any == -1)
+          any = i;
+        if(run_len >= want){
+          hint = run_start;
+          break;
+        }
+      }
+      if(hint == data_block_capacity){
+        if(any == -1)
+          return -1;
+        hint = any;
+      }
+    }
+
+    BITMAP_SET(block_bitmap, hint);
+    /* read_data() refuses blocks past the image's data block count */
+    if(hint >= *data_block_count)
+      *data_block_count = hint + 1;
+    return hint;
+}
+
+/* Function: fs_truncate
+ * Inputs: inode_num - the inode to empty
+ * Return Value: None
+ * Function: Frees all data blocks of the file and drops its cached pages
+ */
+static void fs_truncate(int32_t inode_num){
+    inode_t* inode = &inodes[inode_num];
+    uint32_t i, blocks = (inode->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    for(i = 0; i < blocks; i++){
+      if(inode->data_blocks[i] < data_block_capacity)
+        BITMAP_CLEAR(block_bitmap, inode->data_blocks[i]);
+      page_cache_invalidate(inode_num, i);
+    }
+    /* the cache may also hold the empty page right past the old end */
+    page_cache_invalidate(inode_num, blocks);
+    inode->file_size = 0;
+}
+
+/* Function: fs_create
+ * Inputs: fname - the name of the file, not necessarily null-terminated
+ *         length - the length of the name
+ * Return Value: -1 if failed, 0 if success
+ * Function: Creates an empty regular file. An existing regular file with
+ *           the same name is truncated instead, unless it is mapped
+ */
+int32_t fs_create(const int8_t* fname, uint32_t length){
+    int8_t name[MAX_NAME_LENGTH + 1];
+    uint32_t i, inode_count;
+    dentry_t dent;
+    dentry_t* new_dent;
+
+    if(!fs_writable || !length)
+      return -1;
+    if(length > MAX_NAME_LENGTH)
+      length = MAX_NAME_LENGTH;
+    memset(name, 0, sizeof(name));
+    strncpy(name, fname, length);
+    if(!fn_length(name))
+      return -1;
+
+    if(!read_dentry_by_name(name, &dent)){
+      if(dent.filetype != FILE_TYPE_REG)
+        return -1;
+      /* its blocks would be freed under a live mapping */
+      if(dent.inode_num < FS_MAX_DENTRIES && fs_map_count[dent.inode_num])
+        return -1;
+      fs_truncate(dent.inode_num);
+      return 0;
+    }
+
+    if(dentry_count >= FS_MAX_DENTRIES)
+      return -1;
+
+    /* find a free inode */
+    inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    for(i = 0; i < inode_count && i < FS_MAX_DENTRIES; i++){
+      if(!BITMAP_TEST(inode_bitmap, i))
+        break;
+    }
+    if(i == inode_count || i == FS_MAX_DENTRIES)
+      return -1;
+    BITMAP_SET(inode_bitmap, i);
+    inodes[i].file_size = 0;
+
+    new_dent = fs_dentry(dentry_count);
+    memset(new_dent, 0, sizeof(dentry_t));
+    strncpy(new_dent->filename, name, MAX_NAME_LENGTH);
+    new_dent->filetype = FILE_TYPE_REG;
+    new_dent->inode_num = i;
+    (void)fs_index_insert(dentry_count);
+
+    dentry_count++;
+    /* the boot block only counts the dentries it holds */
+    if(dentry_count <= MAX_FILE_NUM)
+      *((uint32_t*)bblock_ptr) = dentry_count;
+    return 0;
+}
+
+/* Function: fs_index_insert
+ * Inputs: index - the index of the dentry to add to the name index
+ * Return Value: -1 if the index is full, 0 if success
+ * Function: Hashes the dentry's name and links it into its bucket
+ */
+int32_t fs_index_insert(uint32_t index){
+    uint32_t hash, bucket;
+
+    if(index >= FS_MAX_DENTRIES)
+      return -1;
+
+    hash = fs_name_hash(fs_dentry(index)->filename);
+    bucket = hash & (FS_HASH_BUCKETS - 1);
+    fs_hash_vals[index] = hash;
+    fs_hash_next[index] = fs_hash_heads[bucket];
+    fs_hash_heads[bucket] = index;
+    return 0;
+}
+
+/* Function: fs_dentry
+ * Inputs: index - the index of the file in the directory
+ * Return Value: pointer to the dentry
+ * Function: Finds a dentry in the boot block or in the overflow table
+ */
+static dentry_t* fs_dentry(uint32_t index){
+    if(index < MAX_FILE_NUM)
+      return &dentries[index];
+    return &extra_dentries[index - MAX_FILE_NUM];
+}
+
+/* Function: fs_name_hash
+ * Inputs: fname - the file name
+ * Return Value: the 32-bit FNV-1a hash of the name
+ * Function: Hashes at most MAX_NAME_LENGTH characters, the same prefix
+ *           read_dentry_by_name compares
+ */
+static uint32_t fs_name_hash(const int8_t* fname){
+    uint32_t hash = 2166136261U;
+    uint32_t i;
+    for(i = 0; i < MAX_NAME_LENGTH && fname[i] != '\0'; i++){
+      hash ^= (uint8_t)fname[i];
+      hash *= 16777619U;
+    }
+    return hash;
 }
 
 
@@ -65,10 +318,10 @@ int fs_file_open(const int8_t* filename, FILE *file){
  * Inputs: buf - the buffer we want to copy the file data to
  *         length - the number of bytes we want to read
  * Return Value: The number of bytes read
- * Function: Reads the current file
+ * Function: Reads the current file through the page cache
  */
 int fs_file_read(int8_t* buf, uint32_t length, FILE *file){
-    int bytes_read = (int)read_data(file->inode, file->pos, buf, length);
+    int bytes_read = (int)page_cache_read(file->inode, file->pos, buf, length);
     file->pos += bytes_read;
     return bytes_read;
 }
@@ -76,10 +329,63 @@ int fs_file_read(int8_t* buf, uint32_t length, FILE *file){
 /* Function: fs_file_write;
  * Inputs: buf - the buffer we want to write the file data to
  *         length - the number of bytes we want to write
- * Return Value: -1
- * Function: Nothing
+ * Return Value: The number of bytes written, -1 if nothing could be written
+ * Function: Writes at the current position, or at the end of the file
+ *           if the descriptor is in append mode, growing the file as needed.
+ *           New blocks are placed right after the file's last block when
+ *           possible so the file stays contiguous
  */
-int fs_file_write(const int8_t* buf, uint32_t length, FILE *file){ return -1; }
+int fs_file_write(const int8_t* buf, uint32_t length, FILE *file){
+    inode_t* inode;
+    uint32_t pos, block_index, block_off, run_len, blocks;
+    uint32_t num_bytes = 0;
+    uint32_t data_start;
+    int32_t block;
+
+    if(!fs_writable || !buf)
+      return -1;
+
+    inode = &inodes[file->inode];
+    if(file->flags.append)
+      file->pos = inode->file_size;
+    pos = file->pos;
+    if(pos > inode->file_size)
+      return -1;
+    data_start = bblock_ptr + (*((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)) + 1) * BLOCK_SIZE;
+    blocks = (inode->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    while(num_bytes < length){
+      block_index = pos / BLOCK_SIZE;
+      block_off = pos % BLOCK_SIZE;
+      if(block_index >= MAX_BLOCK_NUM)
+        break;
+
+      if(block_index >= blocks){
+        /* ask for enough room for the rest of this write */
+        block = fs_alloc_block(blocks ? inode->data_blocks[blocks - 1] + 1 : 0,
+            (length - num_bytes + BLOCK_SIZE - 1) / BLOCK_SIZE);
+        if(block == -1)
+          break;
+        inode->data_blocks[blocks++] = block;
+      }
+
+      run_len = BLOCK_SIZE - block_off;
+      if(run_len > length - num_bytes)
+        run_len = length - num_bytes;
+      memcpy((void*)(data_start + inode->data_blocks[block_index] * BLOCK_SIZE + block_off), buf + num_bytes, run_len);
+      page_cache_invalidate(file->inode, block_index);
+
+      num_bytes += run_len;
+      pos += run_len;
+      if(pos > inode->file_size)
+        inode->file_size = pos;
+    }
+
+    if(!num_bytes && length)
+      return -1;
+    file->pos = pos;
+    return num_bytes;
+}
 
 /* Function: fs_file_close;
  * Inputs: filename - the file name we want to close
@@ -118,12 +424,16 @@ int fs_dir_read(int8_t* buf, uint32_t length, FILE *file){
 }
 
 /* Function: fs_dir_write;
- * Inputs: buf - the buffer we want to write the file data to
- *         length - the number of bytes we want to write
- * Return Value: -1
- * Function: Nothing
+ * Inputs: buf - the name of the file to create
+ *         length - the length of the name
+ * Return Value: the length of the name, -1 if the file can't be created
+ * Function: Creates (or truncates) a regular file in the directory
  */
-int fs_dir_write(const int8_t* buf, uint32_t length, FILE *file){ return -1; }
+int fs_dir_write(const int8_t* buf, uint32_t length, FILE *file){
+    if(!buf || fs_create(buf, length))
+      return -1;
+    return length;
+}
 
 /* Function: fs_dir_open;
  * Inputs: filename - the file name we want to open
@@ -143,25 +453,19 @@ int fs_dir_close(FILE *file){
  * Function: Copies the data to the dentry variable
  */
 int32_t read_dentry_by_name(const int8_t* fname, dentry_t* dentry){
-    /* loop index */
-    int i;
-    /* temp name holder */
-    /* int8_t cur_name[MAX_NAME_LENGTH]; */
-    int32_t num_dentries = (int32_t)(*((uint32_t*)bblock_ptr));
-    uint32_t name_length;
-    if (!(name_length = fn_length(fname))) {
+    uint32_t hash;
+    uint16_t i;
+
+    if (!fn_length(fname)) {
         return -1;
     }
 
-    /* loops through the dentries, skip the first one because that refers to the
-      directory itself
-    */
-    for(i = 0; i < num_dentries; i++){
-        /* set cur_name to the current dentry filename */
-        /* strncpy(cur_name, (int8_t*)dentries[i].filename, name_length); */
-        /* check to see if the names are the same
-          if they are then copy the relevant values to dentry */
-        if(!strncmp((int8_t*)dentries[i].filename, (int8_t*)fname, MAX_NAME_LENGTH)){
+    /* an empty bucket answers a miss without touching any dentry */
+    hash = fs_name_hash(fname);
+    for(i = fs_hash_heads[hash & (FS_HASH_BUCKETS - 1)]; i != FS_INDEX_NONE; i = fs_hash_next[i]){
+        /* only compare names when the full hashes agree */
+        if(fs_hash_vals[i] == hash
+            && !strncmp((int8_t*)fs_dentry(i)->filename, (int8_t*)fname, MAX_NAME_LENGTH)){
           (void)read_dentry_by_index(i, dentry);
           return 0;
         }
@@ -180,19 +484,20 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
     /*local vars to hold the data we want to copy */
     int32_t file_type;
     int32_t inode_num;
-    uint32_t num_dentries = *(uint32_t*)(bblock_ptr);
+    dentry_t* dent;
     /* check if the index is within acceptable bounds */
-    if(index >= num_dentries || index < 0)
+    if(index >= dentry_count)
         return -1;
     /* get the relevant data to copy */
-    file_type = (int32_t)(dentries[index].filetype);
-    inode_num = (int32_t)(dentries[index].inode_num);
+    dent = fs_dentry(index);
+    file_type = (int32_t)(dent->filetype);
+    inode_num = (int32_t)(dent->inode_num);
 
     /* set dentry to be a copy of the corresponding file sys dentry */
     dentry->filetype = file_type;
     dentry->inode_num = inode_num;
     /* Names do not necessarily include a terminal EOS */
-    strncpy((int8_t*)dentry->filename, (int8_t*)dentries[index].filename, MAX_NAME_LENGTH);
+    strncpy((int8_t*)dentry->filename, (int8_t*)dent->filename, MAX_NAME_LENGTH);
 
     return 0;
 }
@@ -203,76 +508,118 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
  *         buf - the buffer we want to copy data to
  *         length - the number of bytes we want to read
  * Return Value: The number of bytes read
- * Function: Copies the data to the buffer
+ * Function: Copies the data to the buffer. The request is split into runs
+ *           that never cross a data block boundary, and each run is moved
+ *           with a single memcpy
  */
 int32_t read_data(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length){
-    /* for loop index */
-    int i;
     /* local variables used to find byte data*/
     int32_t inode_count;
-    int32_t data_block_count;
+    uint32_t data_block_count;
+    uint32_t file_size;
+    uint32_t block_index;
     uint32_t cur_data_block;
-    int32_t data_offset;
-    uint32_t cur_byte;
-    int starting_index;
-    int32_t actual_len;
-    int8_t* cur_buf_pos;
-    int32_t num_bytes = 0;
+    uint32_t data_offset;
+    uint32_t run_len;
+    uint32_t data_start;
+    uint32_t num_bytes = 0;
 
     /* get the number of inodes */
     inode_count = (int32_t)(*((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)));
 
     /* checks to see if the inode_num is valid */
-    if(inode_num > inode_count || inode_num < 0)
+    if(inode_num >= inode_count || inode_num < 0)
       return 0;
 
     /* get the number of data_blocks */
-    data_block_count = (int32_t)(*((uint32_t*)(bblock_ptr + 2 * BOOT_ENTRIES_OFF)));
+    data_block_count = *((uint32_t*)(bblock_ptr + 2 * BOOT_ENTRIES_OFF));
 
     /* checks to see if the entire file has already been read, return 0 if it has */
-    if(offset >= inodes[inode_num].file_size)
+    file_size = inodes[inode_num].file_size;
+    if(offset >= file_size)
       return 0;
 
-    /* calculates the actual length to be read, truncates the length if it goes over the
-      amount of bytes that have yet to be read */
-    if( (length + offset > inodes[inode_num].file_size) )
-      actual_len = inodes[inode_num].file_size - offset;
-    else
-      actual_len = length;
-
-    /* store buf address with a temp variable that will be iterated through */
-    cur_buf_pos = buf;
-
-    /* calculates the index of which data block number to start on */
-    starting_index = offset / BLOCK_SIZE;
-    /* get the starting data block */
-    cur_data_block = inodes[inode_num].data_blocks[starting_index];
-    /* calculates where in the file to start reading from */
+    /* truncates the length if it goes over the amount of bytes that have yet to be read */
+    if(length > file_size - offset)
+      length = file_size - offset;
+
+    /* data blocks start right after the boot block and the inodes */
+    data_start = bblock_ptr + (inode_count + 1) * BLOCK_SIZE;
+
+    block_index = offset / BLOCK_SIZE;
     data_offset = offset % BLOCK_SIZE;
 
-    /* get the address of the first byte we want to read */
-    cur_byte = bblock_ptr + inode_count * BLOCK_SIZE + cur_data_block * BLOCK_SIZE + data_offset + BLOCK_SIZE;
+    /* copy one block-sized run at a time; only the first run can start in the
+      middle of a block and only the last one can end in the middle of one */
+    while(num_bytes < length){
+        cur_data_block = inodes[inode_num].data_blocks[block_index];
+        /* a corrupted inode must not make us read outside of the image */
+        if(cur_data_block >= data_block_count)
+          break;
 
-    /* loops through all the bytes to be read and copying them to the buffer */
-    for(i = 0; i < actual_len; i++){
-        /* checks to see if we should switch to another data block */
-        if( !((i + data_offset) % BLOCK_SIZE) && (i + data_offset) ){
-          starting_index++;
-          cur_data_block = inodes[inode_num].data_blocks[starting_index];
-          cur_byte = bblock_ptr + inode_count * BLOCK_SIZE + (cur_data_block) * BLOCK_SIZE + BLOCK_SIZE;
-        }
-        /* copy byte data to buffer */
-        *cur_buf_pos = (int8_t)(*((uint32_t*)cur_byte));
-        /* update the buffer to next position to fill */
-        cur_buf_pos++;
-        /* update byte address to the next byte to be read */
-        cur_byte++;
-        /* increment the number of bytes read counter */
-        num_bytes++;
+        run_len = BLOCK_SIZE - data_offset;
+        if(run_len > length - num_bytes)
+          run_len = length - num_bytes;
+
+        memcpy(buf + num_bytes, (void*)(data_start + cur_data_block * BLOCK_SIZE + data_offset), run_len);
+
+        num_bytes += run_len;
+        block_index++;
+        data_offset = 0;
     }
 
     /* return the number of bytes read */
-    return num_bytes;
+    return (int32_t)num_bytes;
+}
+
+/* Function: fs_file_size
+ * Inputs: inode_num - the file's inode number
+ * Return Value: the size of the file in bytes, 0 for a bad inode
+ */
+uint32_t fs_file_size(int32_t inode_num){
+    if(inode_num < 0 || inode_num >= *((int32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)))
+      return 0;
+    return inodes[inode_num].file_size;
+}
+
+/* Function: fs_block_addr
+ * Inputs: inode_num - the file's inode number
+ *         block_index - the block number inside the file
+ * Return Value: the address of the data block in the loaded image, 0 if
+ *               the file has no such block
+ * Function: Lets callers use file data in place, without a copy
+ */
+uint32_t fs_block_addr(int32_t inode_num, uint32_t block_index){
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    uint32_t block;
+
+    if(block_index * BLOCK_SIZE >= fs_file_size(inode_num))
+      return 0;
+    block = inodes[inode_num].data_blocks[block_index];
+    if(block >= *((uint32_t*)(bblock_ptr + BBLOCK_DATA_COUNT_OFF)))
+      return 0;
+    return bblock_ptr + (inode_count + 1 + block) * BLOCK_SIZE;
+}
+
+/* Function: fs_map_get
+ * Inputs: inode_num - the file's inode number
+ * Return Value: None
+ * Function: Records one more mapping of the file; fs_create refuses to
+ *           truncate it until every mapping is put back
+ */
+void fs_map_get(int32_t inode_num){
+    if(inode_num >= 0 && inode_num < FS_MAX_DENTRIES)
+      fs_map_count[inode_num]++;
+}
+
+/* Function: fs_map_put
+ * Inputs: inode_num - the file's inode number
+ * Return Value: None
+ * Function: Drops a mapping recorded by fs_map_get
+ */
+void fs_map_put(int32_t inode_num){
+    if(inode_num >= 0 && inode_num < FS_MAX_DENTRIES && fs_map_count[inode_num])
+      fs_map_count[inode_num]--;
 }
 
 /* Function: fn_length
@@ -15,6 +15,18 @@
 #define BOOT_ENTRIES_OFF           4
 #define INODE_ENTRIES_OFF          4
 
+/* Name index; sized independently of the boot block so it keeps working
+ * when the directory grows past MAX_FILE_NUM entries */
+#define FS_MAX_DENTRIES          256
+#define FS_HASH_BUCKETS          128
+#define FS_INDEX_NONE         0xFFFF
+
+/* Writable mode: data blocks may be allocated past the end of the loaded
+ * image, up to FS_MAX_DATA_BLOCKS and never into the boot stack */
+#define FS_MAX_DATA_BLOCKS      1024
+#define FS_WRITE_LIMIT          TASK_BOOT_KSTACK_TOP
+#define BBLOCK_DATA_COUNT_OFF      8
+
 /* data structures are based off of those discussed in lecture 16 */
 
 file_ops_table_t fs_file_ops_table, fs_dir_ops_table;
@@ -37,7 +49,7 @@ typedef struct inode{
     uint32_t data_blocks[MAX_BLOCK_NUM];
 } inode_t;
 
-void fs_init(uint32_t boot_ptr);
+void fs_init(uint32_t boot_ptr, uint32_t boot_end);
 int32_t fs_open(const int8_t *filename, FILE *file);
 
 int fs_file_open(const int8_t* filename, FILE *file);
@@ -55,5 +67,11 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 int32_t read_data(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length);
 
 uint32_t fn_length(const int8_t* fname);
+int32_t fs_index_insert(uint32_t index);
+int32_t fs_create(const int8_t* fname, uint32_t length);
+uint32_t fs_file_size(int32_t inode_num);
+uint32_t fs_block_addr(int32_t inode_num, uint32_t block_index);
+void fs_map_get(int32_t inode_num);
+void fs_map_put(int32_t inode_num);
 
 #endif
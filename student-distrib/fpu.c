@@ -0,0 +1,154 @@
+#include "fpu.h"
+#include "lib.h"
+#include "syscall.h"
+#include "scheduling.h"
+#include "smp.h"
+
+/* Clear if the CPU has no FXSAVE or SSE; the FPU then stays disabled */
+static uint8_t fpu_present;
+
+static inline uint32_t read_cr0(void) {
+    uint32_t cr0;
+    asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+    return cr0;
+}
+
+static inline void stts(void) {
+    asm volatile ("movl %%cr0, %%eax; orl %0, %%eax; movl %%eax, %%cr0"
+                  : : "i" (CR0_TS) : "eax");
+}
+
+static inline void clts(void) {
+    asm volatile ("clts");
+}
+
+/* Function: fpu_init
+ * Inputs: none
+ * Return Value: none
+ * Description: Checks for FXSAVE and SSE on the boot CPU and sets it up;
+ *              the other CPUs are assumed to match
+ */
+void fpu_init(void) {
+    uint32_t eax = 1, ebx, ecx, edx;
+
+    asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    fpu_present = (edx & (CPUID_FXSR | CPUID_SSE)) == (CPUID_FXSR | CPUID_SSE);
+    fpu_init_cpu();
+}
+
+/* Function: fpu_init_cpu
+ * Inputs: none
+ * Return Value: none
+ * Description: Turns on this CPU's FPU and SSE, with CR0.TS set so the
+ *              first task to use them traps. Without FXSAVE and SSE, CR0.EM
+ *              stays set and FPU instructions fault like any other bad
+ *              instruction
+ */
+void fpu_init_cpu(void) {
+    uint32_t mxcsr = MXCSR_DEFAULT;
+
+    if (!fpu_present) {
+        asm volatile ("movl %%cr0, %%eax; orl %0, %%eax; movl %%eax, %%cr0"
+                      : : "i" (CR0_EM | CR0_TS) : "eax");
+        return;
+    }
+    asm volatile (
+        "movl %%cr4, %%eax; orl %0, %%eax; movl %%eax, %%cr4;"
+        "movl %%cr0, %%eax; andl %1, %%eax; orl %2, %%eax; movl %%eax, %%cr0;"
+        :
+        : "i" (CR4_OSFXSR | CR4_OSXMMEXCPT), "i" (~(CR0_EM | CR0_TS)),
+          "i" (CR0_MP | CR0_NE)
+        : "eax"
+    );
+    asm volatile ("fninit; ldmxcsr %0" : : "m" (mxcsr));
+    stts();
+}
+
+/* Function: fpu_switch
+ * Inputs: prev - the task giving up this CPU, the idle loop, or NULL
+ *         next - the task about to run, or SCHED_IDLE_PCB
+ * Return Value: none
+ * Description: Called on every context switch. The owner's state is saved
+ *              on the way out; only the owner may use the registers
+ *              without trapping first, and only if they were last loaded
+ *              here
+ */
+void fpu_switch(PCB_t *prev, PCB_t *next) {
+    cpu_t *cpu = this_cpu();
+
+    if (!fpu_present) {
+        return;
+    }
+    if (prev && prev == cpu->fpu_owner && prev->fpu_cpu == cpu->id) {
+        asm volatile ("fxsave %0" : "=m" (prev->fpu_state));
+    }
+    if (next == cpu->fpu_owner && next->fpu_cpu == cpu->id) {
+        clts();
+    } else if (!(read_cr0() & CR0_TS)) {
+        stts();
+    }
+}
+
+/* Function: fpu_fault
+ * Inputs: none
+ * Return Value: 0 if the #NM was a lazy switch, -1 if the FPU is disabled
+ * Description: Gives this CPU's registers to the running task, starting it
+ *              from a clean state the first time
+ */
+int32_t fpu_fault(void) {
+    PCB_t *task_pcb = get_cur_pcb();
+    cpu_t *cpu = this_cpu();
+    uint32_t mxcsr = MXCSR_DEFAULT;
+
+    if (!fpu_present || task_pcb == cpu->idle) {
+        return -1;
+    }
+    clts();
+    if (cpu->fpu_owner == task_pcb && task_pcb->fpu_cpu == cpu->id) {
+        return 0;
+    }
+    // The owner's state was saved when it was switched out
+    if (task_pcb->fpu_used) {
+        asm volatile ("fxrstor %0" : : "m" (task_pcb->fpu_state));
+    } else {
+        asm volatile ("fninit; ldmxcsr %0" : : "m" (mxcsr));
+        task_pcb->fpu_used = 1;
+    }
+    cpu->fpu_owner = task_pcb;
+    task_pcb->fpu_cpu = cpu->id;
+    return 0;
+}
+
+/* Function: fpu_save
+ * Inputs: task - the running task
+ * Return Value: none
+ * Description: Brings the task's saved state up to date, for fork to copy
+ */
+void fpu_save(PCB_t *task) {
+    cpu_t *cpu = this_cpu();
+
+    if (cpu->fpu_owner != task || task->fpu_cpu != cpu->id) {
+        return;
+    }
+    clts();
+    asm volatile ("fxsave %0" : "=m" (task->fpu_state));
+}
+
+/* Function: fpu_release
+ * Inputs: task - a task that is exiting or starting its program over
+ * Return Value: none
+ * Description: Forgets the task's state, so that a task reusing its PCB
+ *              can't inherit the registers
+ */
+void fpu_release(PCB_t *task) {
+    cpu_t *cpu = this_cpu();
+
+    task->fpu_used = 0;
+    task->fpu_cpu = FPU_NO_CPU;
+    if (cpu->fpu_owner == task) {
+        cpu->fpu_owner = NULL;
+        if (fpu_present) {
+            stts();
+        }
+    }
+}
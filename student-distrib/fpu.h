@@ -0,0 +1,36 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "task.h"
+
+/* Lazy x87/SSE state switching. Each CPU's registers are left holding the
+ * state of the last task that used them there (the owner); every other task
+ * runs with CR0.TS set, so its first FPU or SSE instruction raises #NM and
+ * only then is its own state loaded. The owner's state is saved when it is
+ * switched out, since it may resume on another CPU, but it gets the
+ * registers back without a restore if nobody used them in between. Tasks
+ * that never touch the FPU never pay for a save or restore */
+
+#define CR0_MP              0x00000002
+#define CR0_EM              0x00000004
+#define CR0_TS              0x00000008
+#define CR0_NE              0x00000020
+#define CR4_OSFXSR          0x00000200
+#define CR4_OSXMMEXCPT      0x00000400
+// CPUID leaf 1, EDX
+#define CPUID_FXSR          (1 << 24)
+#define CPUID_SSE           (1 << 25)
+// MXCSR after reset: every SIMD exception masked, round to nearest
+#define MXCSR_DEFAULT       0x1F80
+// fpu_cpu of a task whose state is in no CPU's registers
+#define FPU_NO_CPU          0xFF
+
+void fpu_init(void);
+void fpu_init_cpu(void);
+void fpu_switch(PCB_t *prev, PCB_t *next);
+int32_t fpu_fault(void);
+void fpu_save(PCB_t *task);
+void fpu_release(PCB_t *task);
+
+#endif
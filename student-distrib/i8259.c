@@ -4,6 +4,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
 
 #define ALL_MASKED    0xFF
 #define TO_UNMASK     0xFE
@@ -13,6 +14,14 @@
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask; /* IRQs 0-7  */
 uint8_t slave_mask;  /* IRQs 8-15 */
+/* Bumped by common_isr for every interrupt it dispatches */
+uint32_t irq_counts[IRQ_STAT_NUM];
+/* With the I/O APIC: the CPU each IRQ goes to, and which are enabled */
+static uint8_t irq_affinity[PIC_IRQ_NUM];
+static uint16_t ioapic_enabled;
+/* EOIs sent by each CPU and the TSC cycles they took */
+static uint32_t eoi_counts[SMP_MAX_CPUS];
+static uint64_t eoi_cycles[SMP_MAX_CPUS];
 
 /* Initialize the 8259 PIC */
 void i8259_init(void) {
@@ -51,6 +60,15 @@ void enable_irq(uint32_t irq_num) {
     uint8_t enable = TO_UNMASK;
     /* check to see if irq_num is within valid range of 0-15*/
     if( (irq_num < 0) || (irq_num > 15) ){ return; }
+    /* The 8259s stay masked once the I/O APIC has the lines */
+    if(ioapic_active){
+      /* The cascade has no pin of its own there; pin 2 is the PIT */
+      if(irq_num == SLAVE_PIC_IRQ)
+        return;
+      ioapic_enabled |= 1 << irq_num;
+      ioapic_route(irq_num, cpus[irq_affinity[irq_num]].apic_id, 0);
+      return;
+    }
     /* checks to see if the intr we want to enable is on the master or slave */
     if(irq_num < SLAVE_IRQ_OFF){
       for(i = 0; i < irq_num; i++)
@@ -76,6 +94,11 @@ void disable_irq(uint32_t irq_num) {
     uint8_t disable = TO_MASK;
     /* check to see if irq_num is within valid range of 0-15*/
     if( (irq_num < 0) || (irq_num > 15) ){ return; }
+    if(ioapic_active){
+      ioapic_enabled &= ~(1 << irq_num);
+      ioapic_route(irq_num, cpus[irq_affinity[irq_num]].apic_id, 1);
+      return;
+    }
     /* checks to see if the intr we want to disable is on the master or slave */
     if(irq_num < SLAVE_IRQ_OFF){
       for(i = 0; i < irq_num; i++)
@@ -96,16 +119,47 @@ void disable_irq(uint32_t irq_num) {
     }
 }
 
-/* Send end-of-interrupt signal for the specified IRQ */
+/* Send end-of-interrupt signal for the specified IRQ; anything that came
+ * through a local APIC (every IRQ, with the I/O APIC) is acknowledged
+ * there with a single memory write */
 void send_eoi(uint32_t irq_num) {
+    uint32_t start = rdtsc_lo();
+    uint32_t cpu;
 
-    /* check to see if irq_num is within valid range of 0-15*/
-    if( (irq_num < 0) || (irq_num > 15) ){ return; }
+    if(irq_num >= PIC_IRQ_NUM || ioapic_active)
+      lapic_eoi();
     /* checks to see if irq_num is on the master or slave */
-    if(irq_num < SLAVE_IRQ_OFF)
+    else if(irq_num < SLAVE_IRQ_OFF)
       outb(irq_num | EOI, MASTER_8259_PORT);
     else{
       outb( (irq_num - SLAVE_IRQ_OFF) | EOI, SLAVE_8259_PORT);
       outb( ICW3_SLAVE | EOI, MASTER_8259_PORT );
     }
+    cpu = this_cpu()->id;
+    eoi_cycles[cpu] += rdtsc_lo() - start;
+    eoi_counts[cpu]++;
+}
+
+/* Send the specified IRQ to the given CPU. Only the I/O APIC can; the
+ * 8259s always interrupt the boot CPU */
+int32_t irq_set_affinity(uint32_t irq_num, uint32_t cpu) {
+    if(!ioapic_active || irq_num >= PIC_IRQ_NUM || cpu >= smp_cpu_count)
+      return -1;
+    irq_affinity[irq_num] = cpu;
+    ioapic_route(irq_num, cpus[cpu].apic_id, !(ioapic_enabled & (1 << irq_num)));
+    return 0;
+}
+
+/* Copy out the interrupt counts */
+void irq_get_stats(irq_stats_t *stats) {
+    uint32_t i;
+
+    memcpy(stats->counts, irq_counts, sizeof(irq_counts));
+    stats->controller = ioapic_active ? IRQ_CONTROLLER_IOAPIC : IRQ_CONTROLLER_8259;
+    stats->eois = 0;
+    stats->eoi_cycles = 0;
+    for(i = 0; i < SMP_MAX_CPUS; i++){
+      stats->eois += eoi_counts[i];
+      stats->eoi_cycles += eoi_cycles[i];
+    }
 }
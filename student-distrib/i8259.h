@@ -7,6 +7,7 @@
 #define _I8259_H
 
 #include "types.h"
+#include "idt.h"
 
 /* Ports that each PIC sits on */
 #define MASTER_8259_PORT    0x20
@@ -34,6 +35,20 @@
 #define SLAVE_PIC_IRQ 	2
 #define RTC_IRQ 		8
 
+// Which controller device interrupts come through
+#define IRQ_CONTROLLER_8259     0
+#define IRQ_CONTROLLER_IOAPIC   1
+
+/* Interrupts taken on each IRQ line, and of each local APIC interrupt,
+ * since boot, counted by common_isr on every CPU, and what acknowledging
+ * them has cost */
+typedef struct {
+    uint32_t counts[IRQ_STAT_NUM];
+    uint32_t controller;
+    uint32_t eois;
+    uint64_t eoi_cycles;
+} irq_stats_t;
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -44,5 +59,9 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Deliver the specified IRQ to one CPU */
+int32_t irq_set_affinity(uint32_t irq_num, uint32_t cpu);
+/* Copy out the interrupt counts */
+void irq_get_stats(irq_stats_t *stats);
 
 #endif /* _I8259_H */
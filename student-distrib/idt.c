@@ -5,9 +5,10 @@
 #include "signals.h"
 #include "syscall.h"
 #include "term.h"
+#include "fpu.h"
 
 void exception_handler(uint32_t irq_num, uint32_t errorcode) {
-    if (irq_num == 14) {    // PF
+    if (irq_num == PF_IDX) {
         uint32_t addr;
         asm volatile ("movl %%cr2, %0;" : "=r" (addr));
         printf(terms, "exception: irq: %u, error: %u, addr: 0x%#x\n", irq_num, errorcode, addr);
@@ -22,6 +23,57 @@ void exception_handler(uint32_t irq_num, uint32_t errorcode) {
     }
 }
 
+/* Function: page_fault_handler;
+ * Inputs: errorcode - error code pushed by the processor
+ * Return Value: none
+ * Description: Backs not-present user pages with frames (filling in the
+ *              program image lazily) and copies copy-on-write pages on
+ *              write; every other page fault is reported like the rest
+ *              of the exceptions
+ */
+void page_fault_handler(uint32_t errorcode) {
+    uint32_t addr;
+    asm volatile ("movl %%cr2, %0;" : "=r" (addr));
+    if (task_fault_in(addr, errorcode) == 0) {
+        return;
+    }
+    exception_handler(PF_IDX, errorcode);
+}
+
+/* Function: device_not_available_handler;
+ * Inputs: none
+ * Return Value: none
+ * Description: #NM is how a task asks for the FPU while CR0.TS is set; it
+ *              is handed the registers and retries the instruction
+ */
+void device_not_available_handler(void) {
+    if (fpu_fault() == 0) {
+        return;
+    }
+    exception_handler(NM_IDX, 0);
+}
+
+/* Function: sysenter_init_cpu;
+ * Inputs: esp0 - this CPU's tss.esp0, which always holds the running
+ *                task's kernel stack
+ * Return Value: none
+ * Description: Points this CPU's SYSENTER MSRs at _sysenter_isr. The stack
+ *              MSR can't follow every context switch cheaply, so it points
+ *              at esp0 and the entry code loads the stack from there. Does
+ *              nothing on a CPU without SYSENTER, where it faults as #UD
+ */
+void sysenter_init_cpu(void *esp0) {
+    uint32_t eax = 1, ebx, ecx, edx;
+
+    asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+    if (!(edx & CPUID_SEP)) {
+        return;
+    }
+    asm volatile ("wrmsr" : : "c" (IA32_SYSENTER_CS), "a" (KERNEL_CS), "d" (0));
+    asm volatile ("wrmsr" : : "c" (IA32_SYSENTER_ESP), "a" ((uint32_t) esp0), "d" (0));
+    asm volatile ("wrmsr" : : "c" (IA32_SYSENTER_EIP), "a" ((uint32_t) _sysenter_isr), "d" (0));
+}
+
 /* Function creates everything as interrupt gates as recommended by descriptor doc
  * "For simplicity,use interrupt gates for everything"
  * https://courses.engr.illinois.edu/ece391/sp2019/secure/references/descriptors.pdf
@@ -4,19 +4,61 @@
 #include "types.h"
 
 #define SYSCALL_IDX     0x80
+#define NM_IDX          7
+#define PF_IDX          14
+// Page fault error code bit: set if the page was present (protection fault)
+#define PF_ERR_PRESENT  0x1
+// Page fault error code bit: set if the access was a write
+#define PF_ERR_WRITE    0x2
+// Number of entries in SYSCALL_JMP_TAB
+#define SYSCALL_NUM     27
+
+// SYSENTER takes CS and SS from the first MSR, and SYSEXIT the user ones
+// from the GDT entries after them, which is the order the GDT already has
+#define IA32_SYSENTER_CS    0x174
+#define IA32_SYSENTER_ESP   0x175
+#define IA32_SYSENTER_EIP   0x176
+// CPUID leaf 1, EDX
+#define CPUID_SEP           (1 << 11)
+// halt, sigreturn and fork work on the interrupt frame, which the
+// SYSENTER path doesn't build; they have to come through int 0x80
+#define SYSENTER_DENY       ((1 << 1) | (1 << 10) | (1 << 16))
+// Calls syscall_batch won't run: the same ones, whose frame would be the
+// batch's, and batch itself
+#define SYSCALL_BATCH_DENY  (SYSENTER_DENY | (1 << 20))
 
 // Interrupt indexes
 #define PIT_INT     0x20
 #define KB_INT			0x21
 #define SLAVE_PIC_INT	0x22
 #define RTC_INT 		0x28
+// Inter-processor interrupts, sent through the local APICs
+#define IPI_TICK_INT    0xF0
+#define IPI_RESCHED_INT 0xF1
+#define LAPIC_TIMER_INT 0xF2
+#define SPURIOUS_INT    0xFF
+
+// common_isr numbers the local APIC's own interrupts after the 16 ISA lines
+#define PIC_IRQ_NUM     16
+#define IPI_TICK_IRQ    16
+#define IPI_RESCHED_IRQ 17
+#define LAPIC_TIMER_IRQ 18
+#define IRQ_STAT_NUM    19
 
 #ifndef ASM
 
 void exception_handler(uint32_t irq_num, uint32_t errorcode);
+void page_fault_handler(uint32_t errorcode);
+void device_not_available_handler(void);
 
 /* initializes the idt array */
 extern void idt_init(void);
+void sysenter_init_cpu(void *esp0);
+
+/* Every system call can be called through this; the ones with fewer
+ * arguments ignore the rest */
+typedef int32_t (*syscall_fn_t)(int32_t a, int32_t b, int32_t c);
+extern syscall_fn_t SYSCALL_JMP_TAB[SYSCALL_NUM];
 
 // Exception asm handlers
 extern int _de_isr(void);
@@ -57,6 +99,11 @@ extern int _ps2m_isr(void);
 extern int _fpu_isr(void);
 extern int _hd1_isr(void);
 extern int _hd2_isr(void);
+extern int _ipi_tick_isr(void);
+extern int _ipi_resched_isr(void);
+extern int _lapic_timer_isr(void);
+extern int _spurious_isr(void);
+extern int _sysenter_isr(void);
 
 extern int _syscall_isr(void);
 
@@ -0,0 +1,323 @@
+#include "io_ring.h"
+#include "lib.h"
+#include "page.h"
+#include "syscall.h"
+#include "scheduling.h"
+#include "spinlock.h"
+
+/* Tasks in io_ring_enter waiting for any of their files. Drivers don't
+ * know which files a ring waits for, so they wake all of them with
+ * io_notify and each checks its own again */
+static wait_queue_t io_wq;
+static spinlock_t io_lock = SPINLOCK_INIT;
+
+/* io_file_ready
+ *  Descrption: Asks the file's driver whether a read or write would go
+ *      through without sleeping. Files without a poll op never sleep, and
+ *      a closed descriptor is ready to fail
+ *  Arg:
+ *      file: an entry of the running task's open files
+ *      events: POLL_IN, POLL_OUT or both
+ *
+ * 	RETURN:
+ *      the events that are ready
+ */
+int32_t io_file_ready(FILE *file, int32_t events) {
+    if (!file->flags.used || !file->file_ops->poll) {
+        return events;
+    }
+    return file->file_ops->poll(file) & events;
+}
+
+/* io_file_wait
+ *  Descrption: Tells the file's driver the task starts (delta 1) or stops
+ *      (delta -1) waiting for it, through its poll_wait op
+ */
+static void io_file_wait(PCB_t *task, int32_t fd, int32_t delta) {
+    FILE *file;
+
+    if (fd < 0 || fd >= TASK_MAX_FILES) {
+        return;
+    }
+    file = &task->open_files[fd];
+    if (file->flags.used && file->file_ops->poll_wait) {
+        file->file_ops->poll_wait(file, delta);
+    }
+}
+
+/* io_notify
+ *  Descrption: Called by drivers, after dropping their own lock, when a
+ *      file may have become ready. Safe in interrupt handlers
+ */
+void io_notify(void) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&io_lock, flags);
+    sched_wake_all(&io_wq);
+    spin_unlock_irqrestore(&io_lock, flags);
+}
+
+/* io_poll_scan
+ *  Descrption: Fills in revents for each descriptor. Called with io_lock
+ *      held, like io_ring_any_ready
+ *
+ * 	RETURN:
+ *      how many descriptors have something to report
+ */
+static int32_t io_poll_scan(PCB_t *task, poll_fd_t *fds, uint32_t nfds) {
+    uint32_t i;
+    int32_t nready = 0;
+
+    for (i = 0; i < nfds; i++) {
+        if (fds[i].fd < 0) {
+            fds[i].revents = 0;
+            continue;
+        }
+        if (fds[i].fd >= TASK_MAX_FILES || !task->open_files[fds[i].fd].flags.used) {
+            fds[i].revents = POLL_NVAL;
+        } else {
+            fds[i].revents = io_file_ready(&task->open_files[fds[i].fd],
+                    fds[i].events & (POLL_IN | POLL_OUT));
+        }
+        if (fds[i].revents) {
+            nready++;
+        }
+    }
+    return nready;
+}
+
+/* io_poll
+ *  Descrption: Waits until a read or write on any of the descriptors would
+ *      go through without sleeping. There are no timers to wake a task at
+ *      a given time, so the only timeouts are none and forever; an RTC
+ *      descriptor in the set gives a periodic one
+ *  Arg:
+ *      task: the running task
+ *      fds: a copy of the task's set, in kernel memory
+ *      nfds: its length
+ *      timeout: 0 to only check, negative to wait
+ *
+ * 	RETURN:
+ *      the number of descriptors with revents set, or -1 for a positive
+ *      timeout
+ */
+int32_t io_poll(PCB_t *task, poll_fd_t *fds, uint32_t nfds, int32_t timeout) {
+    uint32_t flags, i;
+    int32_t nready;
+
+    if (timeout > 0) {
+        return -1;
+    }
+    // Only a wait registers; a check alone leaves the drivers as they are
+    for (i = 0; timeout && i < nfds; i++) {
+        io_file_wait(task, fds[i].fd, 1);
+    }
+    spin_lock_irqsave(&io_lock, flags);
+    while (!(nready = io_poll_scan(task, fds, nfds)) && timeout) {
+        sched_sleep(&io_wq, &io_lock);
+    }
+    spin_unlock_irqrestore(&io_lock, flags);
+    for (i = 0; timeout && i < nfds; i++) {
+        io_file_wait(task, fds[i].fd, -1);
+    }
+    return nready;
+}
+
+/* Completions the task hasn't taken yet */
+static uint32_t io_cq_count(io_ring_shared_t *shared) {
+    return shared->cq_tail - shared->cq_head;
+}
+
+static int32_t io_sqe_ready(PCB_t *task, io_sqe_t *sqe) {
+    if (sqe->fd < 0 || sqe->fd >= TASK_MAX_FILES) {
+        return 1;
+    }
+    return io_file_ready(&task->open_files[sqe->fd],
+            sqe->opcode == IO_OP_WRITE ? POLL_OUT : POLL_IN);
+}
+
+/* The same checks and file ops as the read and write system calls */
+static int32_t io_sqe_run(io_sqe_t *sqe) {
+    switch (sqe->opcode) {
+        case IO_OP_READ:
+            return syscall_read(sqe->fd, (void *) sqe->buf, sqe->len);
+        case IO_OP_WRITE:
+            return syscall_write(sqe->fd, (const void *) sqe->buf, sqe->len);
+    }
+    return -1;
+}
+
+/* io_ring_run
+ *  Descrption: Runs each pending op whose file is ready, unless an older
+ *      op on the same descriptor is still waiting, and posts its
+ *      completion; keeps the rest in order. Stops completing once the
+ *      completion ring is full
+ *  Arg:
+ *      task: the running task
+ *      ring: its ring
+ */
+static void io_ring_run(PCB_t *task, io_ring_t *ring) {
+    io_ring_shared_t *shared = ring->shared;
+    uint32_t i, kept = 0;
+    // Descriptors with an op left waiting
+    uint32_t blocked = 0;
+    io_sqe_t *sqe;
+    io_cqe_t *cqe;
+
+    for (i = 0; i < ring->npending; i++) {
+        sqe = &ring->pending[i];
+        if (io_cq_count(shared) >= IO_RING_ENTRIES
+                || (sqe->fd >= 0 && sqe->fd < TASK_MAX_FILES && (blocked & (1 << sqe->fd)))
+                || !io_sqe_ready(task, sqe)) {
+            if (sqe->fd >= 0 && sqe->fd < TASK_MAX_FILES) {
+                blocked |= 1 << sqe->fd;
+            }
+            ring->pending[kept++] = *sqe;
+            continue;
+        }
+        cqe = &shared->cqes[shared->cq_tail & IO_RING_MASK];
+        cqe->result = io_sqe_run(sqe);
+        cqe->user_data = sqe->user_data;
+        // The entry is filled in before the task can see it
+        asm volatile ("" : : : "memory");
+        shared->cq_tail++;
+    }
+    ring->npending = kept;
+}
+
+/* io_ring_any_ready
+ *  Descrption: Whether io_ring_run could complete anything now. Called
+ *      with io_lock held, so a driver's io_notify can't slip in between
+ *      this and going to sleep
+ */
+static int32_t io_ring_any_ready(PCB_t *task, io_ring_t *ring) {
+    uint32_t i;
+
+    for (i = 0; i < ring->npending; i++) {
+        if (io_sqe_ready(task, &ring->pending[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Registers, or with delta -1 unregisters, the ring's wait on the files of
+ * its pending ops; each op counts once */
+static void io_ring_wait(PCB_t *task, io_ring_t *ring, int32_t delta) {
+    uint32_t i;
+
+    for (i = 0; i < ring->npending; i++) {
+        io_file_wait(task, ring->pending[i].fd, delta);
+    }
+}
+
+/* io_ring_setup
+ *  Descrption: Gives the task its ring, with the shared page mapped
+ *      writable at the top of its mmap area, out of the way of mmap's
+ *      first fit
+ *  Arg:
+ *      task: the running task
+ *
+ * 	RETURN:
+ *      the user address of the shared page, or -1 if the task already has
+ *      a ring or there is no memory or room for it
+ */
+int32_t io_ring_setup(PCB_t *task) {
+    io_ring_t *ring;
+    io_ring_shared_t *shared;
+    int32_t i;
+
+    if (task->io_ring) {
+        return -1;
+    }
+    for (i = MAX_ENTRIES - 1; i >= 0 && task->mmap_pt[i].present; i--);
+    if (i < 0) {
+        return -1;
+    }
+    ring = (io_ring_t *) frame_alloc();
+    shared = (io_ring_shared_t *) frame_alloc();
+    if (!ring || !shared) {
+        if (ring) {
+            frame_free((uint32_t) ring);
+        }
+        if (shared) {
+            frame_free((uint32_t) shared);
+        }
+        return -1;
+    }
+    memset(ring, 0, PAGE_SIZE);
+    memset(shared, 0, PAGE_SIZE);
+    ring->shared = shared;
+    ring->pte_index = i;
+    set_pte(&task->mmap_pt[i], (uint32_t) shared, 1, 1);
+    task->io_ring = ring;
+    return TASK_MMAP_START + i * PAGE_SIZE;
+}
+
+/* io_ring_enter
+ *  Descrption: Takes up to to_submit new ops off the submission ring and
+ *      runs whatever is ready, then sleeps until at least min_complete
+ *      completions are waiting to be taken. Returns early if nothing in
+ *      flight could make up the difference or the completion ring is full
+ *  Arg:
+ *      task: the running task
+ *      to_submit: most submissions to take
+ *      min_complete: completions to wait for; 0 to only submit and reap
+ *
+ * 	RETURN:
+ *      the number of submissions taken, or -1 if the task has no ring
+ */
+int32_t io_ring_enter(PCB_t *task, uint32_t to_submit, uint32_t min_complete) {
+    io_ring_t *ring = task->io_ring;
+    io_ring_shared_t *shared;
+    uint32_t submitted = 0;
+    uint32_t flags;
+
+    if (!ring) {
+        return -1;
+    }
+    shared = ring->shared;
+    while (submitted < to_submit && ring->npending < IO_RING_ENTRIES
+            && shared->sq_head != shared->sq_tail) {
+        ring->pending[ring->npending++] = shared->sqes[shared->sq_head & IO_RING_MASK];
+        shared->sq_head++;
+        submitted++;
+    }
+
+    while (1) {
+        io_ring_run(task, ring);
+        if (io_cq_count(shared) >= min_complete || !ring->npending
+                || io_cq_count(shared) >= IO_RING_ENTRIES) {
+            break;
+        }
+        // Registered before the check, so input that comes in between is
+        // kept for it
+        io_ring_wait(task, ring, 1);
+        spin_lock_irqsave(&io_lock, flags);
+        if (!io_ring_any_ready(task, ring)) {
+            sched_sleep(&io_wq, &io_lock);
+        }
+        spin_unlock_irqrestore(&io_lock, flags);
+        io_ring_wait(task, ring, -1);
+    }
+    return submitted;
+}
+
+/* io_ring_release
+ *  Descrption: Drops the task's ring and anything still in flight on it.
+ *      Called when the task halts
+ *  Arg:
+ *      task: the running task
+ */
+void io_ring_release(PCB_t *task) {
+    io_ring_t *ring = task->io_ring;
+
+    if (!ring) {
+        return;
+    }
+    clear_pte(&task->mmap_pt[ring->pte_index]);
+    flush_tlb_page(TASK_MMAP_START + ring->pte_index * PAGE_SIZE);
+    frame_free((uint32_t) ring->shared);
+    frame_free((uint32_t) ring);
+    task->io_ring = NULL;
+}
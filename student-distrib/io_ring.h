@@ -0,0 +1,79 @@
+#ifndef _IO_RING_H
+#define _IO_RING_H
+
+/* Relevant citations and sources
+ * https://kernel.dk/io_uring.pdf
+ */
+
+#include "types.h"
+#include "task.h"
+
+/* Asynchronous reads and writes through a pair of rings in a page shared
+ * with the task. The task fills in submissions and moves sq_tail; the
+ * kernel takes them in io_enter and puts a completion on the other ring
+ * for each, once the file is ready. Ops on one descriptor complete in the
+ * order they were submitted. Both rings have the same size, and the
+ * kernel keeps no more ops in flight than there is room for completions */
+
+#define IO_RING_ENTRIES     64
+#define IO_RING_MASK        (IO_RING_ENTRIES - 1)
+
+// Submission opcodes; a read of an RTC descriptor waits for its next tick
+#define IO_OP_READ          0
+#define IO_OP_WRITE         1
+
+typedef struct {
+    uint32_t opcode;
+    int32_t fd;
+    uint32_t buf;
+    uint32_t len;
+    // Handed back in the completion, untouched
+    uint32_t user_data;
+} io_sqe_t;
+
+typedef struct {
+    uint32_t user_data;
+    // What read or write would have returned
+    int32_t result;
+} io_cqe_t;
+
+/* The shared page. Indexes only ever count up; an entry is at the index
+ * masked with IO_RING_MASK */
+typedef struct {
+    volatile uint32_t sq_head;      // written by the kernel
+    volatile uint32_t sq_tail;      // written by the task
+    volatile uint32_t cq_head;      // written by the task
+    volatile uint32_t cq_tail;      // written by the kernel
+    io_sqe_t sqes[IO_RING_ENTRIES];
+    io_cqe_t cqes[IO_RING_ENTRIES];
+} io_ring_shared_t;
+
+/* The kernel's side, in a frame of its own; only the task itself uses it */
+typedef struct io_ring {
+    io_ring_shared_t *shared;
+    // Entry of the task's mmap page table the shared page is mapped at
+    uint32_t pte_index;
+    // Taken off the submission ring, waiting for their file, oldest first
+    uint32_t npending;
+    io_sqe_t pending[IO_RING_ENTRIES];
+} io_ring_t;
+
+/* For the poll system call: one descriptor to watch, the POLL_IN and
+ * POLL_OUT events wanted, and those found ready. A negative fd is skipped */
+typedef struct {
+    int32_t fd;
+    int16_t events;
+    int16_t revents;
+} poll_fd_t;
+
+// Most descriptors one poll call watches
+#define IO_POLL_MAX         TASK_MAX_FILES
+
+int32_t io_file_ready(FILE *file, int32_t events);
+void io_notify(void);
+int32_t io_ring_setup(PCB_t *task);
+int32_t io_ring_enter(PCB_t *task, uint32_t to_submit, uint32_t min_complete);
+void io_ring_release(PCB_t *task);
+int32_t io_poll(PCB_t *task, poll_fd_t *fds, uint32_t nfds, int32_t timeout);
+
+#endif /* _IO_RING_H */
@@ -0,0 +1,107 @@
+#include "kdata.h"
+#include "lib.h"
+#include "apic.h"
+#include "spinlock.h"
+
+kdata_page_t __attribute__((aligned (4096))) kdata_page;
+kdata_cpu_page_t __attribute__((aligned (4096))) kdata_cpu_pages[SMP_MAX_CPUS];
+/* Keeps writers on different CPUs from interleaving; readers never take it */
+static spinlock_t kdata_lock = SPINLOCK_INIT;
+
+/* Function: kdata_write_begin
+ * Inputs: none
+ * Return Value: none
+ * Description: seq goes odd before anything changes, so a reader that saw
+ *              the old value of seq retries
+ */
+static void kdata_write_begin(void) {
+    spin_lock(&kdata_lock);
+    kdata_page.data.seq++;
+    asm volatile ("" : : : "memory");
+}
+
+static void kdata_write_end(void) {
+    asm volatile ("" : : : "memory");
+    kdata_page.data.seq++;
+    spin_unlock(&kdata_lock);
+}
+
+/* Function: kdata_init
+ * Inputs: none
+ * Return Value: none
+ * Description: Measures the TSC against PIT channel 2, which nothing else
+ *              uses yet, and starts the clock at zero
+ */
+void kdata_init(void) {
+    kdata_t *kd = &kdata_page.data;
+    uint64_t start = rdtsc();
+    uint32_t khz, mult, dummy;
+
+    apic_delay_us(KDATA_CALIBRATE_US);
+    khz = (uint32_t) (rdtsc() - start) / (KDATA_CALIBRATE_US / 1000);
+    // (1000 << 32) / khz; no 64-bit division in the kernel. The quotient
+    // fits as long as the TSC runs faster than 1 MHz
+    asm ("divl %3" : "=a" (mult), "=d" (dummy) : "0" (0), "r" (khz), "1" (1000));
+
+    kd->tsc_khz = khz;
+    kd->us_mult = mult;
+    kd->clock_tsc = rdtsc();
+}
+
+/* Function: kdata_advance_clock
+ * Inputs: kd - the shared page, with seq odd
+ * Return Value: none
+ * Description: Moves the clock up to now. The fraction is carried over,
+ *              so updating more often doesn't make it drift
+ */
+static void kdata_advance_clock(kdata_t *kd) {
+    uint64_t now = rdtsc();
+    uint64_t elapsed = (now - kd->clock_tsc) * kd->us_mult + kd->clock_frac;
+
+    kd->clock_us += elapsed >> 32;
+    kd->clock_frac = (uint32_t) elapsed;
+    kd->clock_tsc = now;
+}
+
+/* Function: kdata_update_clock
+ * Inputs: none
+ * Return Value: none
+ * Description: Called on timer ticks, and with kdata_rtc_tick on RTC
+ *              interrupts, which keep coming while the timers are stopped.
+ *              Either is often enough that the cycles since the last
+ *              update times us_mult can't overflow, for readers either
+ */
+void kdata_update_clock(void) {
+    kdata_write_begin();
+    kdata_advance_clock(&kdata_page.data);
+    kdata_write_end();
+}
+
+/* Function: kdata_rtc_tick
+ * Inputs: freq - the RTC's interrupt rate
+ * Return Value: none
+ */
+void kdata_rtc_tick(uint32_t freq) {
+    kdata_t *kd = &kdata_page.data;
+
+    kdata_write_begin();
+    kdata_advance_clock(kd);
+    kd->rtc_ticks++;
+    kd->rtc_freq = freq;
+    kdata_write_end();
+}
+
+/* Function: kdata_set_task
+ * Inputs: cpu - the CPU about to run the task
+ *         task - the task
+ * Return Value: none
+ * Description: Only that CPU writes its page and only while it isn't
+ *              running user code, so there is nothing to lock
+ */
+void kdata_set_task(uint8_t cpu, PCB_t *task) {
+    kdata_cpu_t *kc = &kdata_cpu_pages[cpu].data;
+
+    kc->pid = task->pid;
+    kc->term_ind = task->term_ind;
+    kc->cpu = cpu;
+}
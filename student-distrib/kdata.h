@@ -0,0 +1,64 @@
+#ifndef _KDATA_H
+#define _KDATA_H
+
+/* Relevant citations and sources
+ * https://man7.org/linux/man-pages/man7/vdso.7.html
+ * https://lwn.net/Articles/615809/ (vDSO clock reads)
+ */
+
+#include "types.h"
+#include "page.h"
+#include "smp.h"
+#include "task.h"
+
+/* Kernel data every task can read without a syscall. Two read-only user
+ * pages follow video memory: the first is shared by everyone, the second
+ * is the running CPU's own and describes the task running there, so it
+ * always shows the task that reads it */
+
+// TSC cycles the clock is calibrated over, in microseconds
+#define KDATA_CALIBRATE_US  10000
+
+/* Written with seq odd; a reader retries if seq was odd or changed while
+ * it read. The clock is a 32.32 fixed point count of microseconds since
+ * boot, as of clock_tsc; readers add the cycles since then times us_mult */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t tsc_khz;
+    // Microseconds per TSC cycle, times 2^32
+    uint32_t us_mult;
+    uint32_t clock_frac;
+    uint64_t clock_us;
+    uint64_t clock_tsc;
+    // RTC interrupts since boot, and how many of them a second there are now
+    uint32_t rtc_ticks;
+    uint32_t rtc_freq;
+} kdata_t;
+
+typedef struct {
+    uint32_t pid;
+    uint32_t term_ind;
+    uint32_t cpu;
+} kdata_cpu_t;
+
+/* Padded out to whole pages, so tasks see nothing else the kernel keeps */
+typedef union {
+    kdata_t data;
+    uint8_t page[PAGE_SIZE];
+} kdata_page_t;
+
+typedef union {
+    kdata_cpu_t data;
+    uint8_t page[PAGE_SIZE];
+} kdata_cpu_page_t;
+
+/* Mapped into every task by init_page */
+extern kdata_page_t kdata_page;
+extern kdata_cpu_page_t kdata_cpu_pages[SMP_MAX_CPUS];
+
+void kdata_init(void);
+void kdata_update_clock(void);
+void kdata_rtc_tick(uint32_t freq);
+void kdata_set_task(uint8_t cpu, PCB_t *task);
+
+#endif /* _KDATA_H */
@@ -16,15 +16,14 @@
 #include "file_sys.h"
 #include "signals.h"
 #include "scheduling.h"
+#include "fpu.h"
+#include "smp.h"
+#include "kdata.h"
 
 extern int32_t do_syscall(int32_t a, int32_t b, int32_t c, int32_t d);
 
 /* #define RUN_TESTS */
 
-/* Macros. */
-/* Check if the bit BIT in FLAGS is set. */
-#define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
-
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
@@ -93,11 +92,20 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Getting the File System boot block address */
    module_t* mod = (module_t*)mbi->mods_addr;
    uint32_t bblock_addr = (uint32_t)mod->mod_start;
+   uint32_t bblock_end = (uint32_t)mod->mod_end;
 
     /* Init the IDT */
     idt_init();
+    /* Seed the frame allocator while the multiboot info is still reachable */
+    frame_init((uint32_t) mbi);
     /* Init Paging */
     init_page();
+    /* Calibrate the clock tasks read from the shared data page */
+    kdata_init();
+    /* Enable the FPU and SSE; task state is switched lazily */
+    fpu_init();
+    /* Start the other CPUs; they idle until there are tasks */
+    smp_init();
     /* Init the PIC */
     i8259_init();
     /* Init the RTC */
@@ -106,11 +114,10 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Init the keyboard */
 	init_kb();
     /* Init the File System */
-    fs_init(bblock_addr);
+    fs_init(bblock_addr, bblock_end);
     init_term();
     init_pit();
 
-	while (1) {
-		asm volatile ("hlt;");
-	}
+    /* The boot context becomes the idle task */
+    sched_idle_loop();
 }
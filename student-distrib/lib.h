@@ -30,6 +30,11 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 
+/* Bit i of an array of uint32_t used as a bitmap */
+#define BITMAP_TEST(map, i)     ((map)[(i) >> 5] & (1 << ((i) & 0x1F)))
+#define BITMAP_SET(map, i)      ((map)[(i) >> 5] |= (1 << ((i) & 0x1F)))
+#define BITMAP_CLEAR(map, i)    ((map)[(i) >> 5] &= ~(1 << ((i) & 0x1F)))
+
 /* Userspace address-check functions */
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
@@ -81,6 +86,25 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the low 32 bits of the time stamp counter; good for timing
+ * anything shorter than a second or so */
+static inline uint32_t rdtsc_lo(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return lo;
+}
+
+/* Reads the whole time stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc"
+            : "=a"(lo), "=d"(hi)
+    );
+    return ((uint64_t) hi << 32) | lo;
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -0,0 +1,285 @@
+#include "malloc.h"
+#include "lib.h"
+
+#define HEAP_MAP ((malloc_heap_t *) MALLOC_HEAP_MAP_START)
+/* Word at the given offset into the heap; a block's header is at its
+ * offset, its footer in its last word, and a free block keeps its next and
+ * previous list links right after the header */
+#define HEAP_WORD(off)  (*(uint32_t *) (HEAP_START + (off)))
+#define BLOCK_NEXT(off) HEAP_WORD((off) + 4)
+#define BLOCK_PREV(off) HEAP_WORD((off) + 8)
+#define TAG_SIZE(tag)   ((tag) & ~(MALLOC_ALIGN - 1))
+/* Word and bit of heap->live for the block at off */
+#define LIVE_WORD(off)  (HEAP_MAP->live[(off) / MALLOC_MIN_BLOCK / 32])
+#define LIVE_BIT(off)   (1 << ((off) / MALLOC_MIN_BLOCK % 32))
+/* The first block starts one word in so that payloads are 8 byte aligned;
+ * the last word of the heap is left over for the same reason */
+#define FIRST_BLOCK     4
+#define BLOCKS_END      (MALLOC_HEAP_SIZE - 4)
+
+/* Function: bit_high
+ * Inputs: x - a non-zero word
+ * Return Value: index of the highest set bit
+ */
+static inline uint32_t bit_high(uint32_t x){
+    uint32_t i;
+    asm ("bsrl %1, %0" : "=r"(i) : "rm"(x) : "cc");
+    return i;
+}
+
+/* Function: bit_low
+ * Inputs: x - a non-zero word
+ * Return Value: index of the lowest set bit
+ */
+static inline uint32_t bit_low(uint32_t x){
+    uint32_t i;
+    asm ("bsfl %1, %0" : "=r"(i) : "rm"(x) : "cc");
+    return i;
+}
+
+/* Function: size_class
+ * Inputs: size - block size, at least MALLOC_MIN_BLOCK
+ * Return Value: the list holding free blocks of this size
+ */
+static uint32_t size_class(uint32_t size){
+    return bit_high(size) - MALLOC_MIN_SHIFT;
+}
+
+/* Function: block_in_heap
+ * Inputs: off - a block offset read from the task's memory
+ * Return Value: 1 if a block can start there
+ */
+static int32_t block_in_heap(uint32_t off){
+    return off >= FIRST_BLOCK && off <= BLOCKS_END - MALLOC_MIN_BLOCK
+        && (off & (MALLOC_ALIGN - 1)) == FIRST_BLOCK;
+}
+
+/* Function: set_tags
+ * Inputs: off - the block
+ *         size - its size in bytes, tags included
+ *         used - MALLOC_TAG_USED or 0
+ */
+static void set_tags(uint32_t off, uint32_t size, uint32_t used){
+    HEAP_WORD(off) = size | used;
+    HEAP_WORD(off + size - 4) = size | used;
+}
+
+/* Function: list_insert
+ * Inputs: off - a free block
+ *         size - its size
+ * Description: Pushes the block on the front of its size class's list
+ */
+static void list_insert(uint32_t off, uint32_t size){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t c = size_class(size);
+    uint32_t next = heap->free_lists[c];
+
+    BLOCK_NEXT(off) = next;
+    BLOCK_PREV(off) = MALLOC_NIL;
+    if (next != MALLOC_NIL)
+        BLOCK_PREV(next) = off;
+    heap->free_lists[c] = off;
+    heap->class_map |= 1 << c;
+}
+
+/* Function: list_remove
+ * Inputs: off - a free block
+ *         size - its size
+ * Return Value: 0 on success, -1 if its links are corrupt
+ */
+static int32_t list_remove(uint32_t off, uint32_t size){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t c = size_class(size);
+    uint32_t next = BLOCK_NEXT(off);
+    uint32_t prev = BLOCK_PREV(off);
+
+    if ((next != MALLOC_NIL && !block_in_heap(next))
+            || (prev != MALLOC_NIL && !block_in_heap(prev)))
+        return -1;
+    if (prev == MALLOC_NIL)
+        heap->free_lists[c] = next;
+    else
+        BLOCK_NEXT(prev) = next;
+    if (next != MALLOC_NIL)
+        BLOCK_PREV(next) = prev;
+    if (heap->free_lists[c] == MALLOC_NIL)
+        heap->class_map &= ~(1 << c);
+    return 0;
+}
+
+/* Function: free_block_fits
+ * Inputs: off - head of a free list, or MALLOC_NIL
+ *         size - block size wanted
+ * Return Value: the block's size if it is free and big enough, else 0
+ */
+static uint32_t free_block_fits(uint32_t off, uint32_t size){
+    uint32_t tag, block_size;
+
+    if (!block_in_heap(off))
+        return 0;
+    tag = HEAP_WORD(off);
+    block_size = TAG_SIZE(tag);
+    if ((tag & MALLOC_TAG_USED) || block_size < size || off + block_size > BLOCKS_END)
+        return 0;
+    return block_size;
+}
+
+/* Function: heap_init
+ * Description: Turns the whole heap into one free block
+ */
+static void heap_init(void){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t size = BLOCKS_END - FIRST_BLOCK;
+    int i;
+
+    heap->class_map = 0;
+    for (i = 0; i < MALLOC_CLASS_NUM; i++)
+        heap->free_lists[i] = MALLOC_NIL;
+    memset(heap->live, 0, sizeof(heap->live));
+    set_tags(FIRST_BLOCK, size, 0);
+    list_insert(FIRST_BLOCK, size);
+    heap->free_bytes = size;
+    heap->used_blocks = 0;
+    heap->free_blocks = 1;
+    heap->ready = 1;
+}
+
+/* Function: heap_alloc
+ * Inputs: size - number of bytes wanted
+ * Return Value: an 8 byte aligned pointer into the calling task's heap, or
+ *               NULL if size is 0 or no free block is big enough
+ * Description: Takes the first block of the smallest list whose blocks are
+ *              all big enough, found with one bit scan, and splits off the
+ *              tail if it can stand as a block of its own
+ */
+uint8_t *heap_alloc(uint32_t size){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t need, c, mask, off, block_size;
+
+    if (!size || size > MALLOC_HEAP_SIZE)
+        return NULL;
+    if (!heap->ready)
+        heap_init();
+
+    need = (size + MALLOC_TAGS_SIZE + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+    if (need < MALLOC_MIN_BLOCK)
+        need = MALLOC_MIN_BLOCK;
+
+    // The head of need's own class is worth one look before going up
+    c = size_class(need);
+    off = heap->free_lists[c];
+    if (!(block_size = free_block_fits(off, need))) {
+        if (need & (need - 1))
+            c++;
+        mask = c < MALLOC_CLASS_NUM ? heap->class_map & ~((1 << c) - 1) : 0;
+        if (!mask)
+            return NULL;
+        off = heap->free_lists[bit_low(mask)];
+        if (!(block_size = free_block_fits(off, need)))
+            return NULL;
+    }
+    if (list_remove(off, block_size) == -1)
+        return NULL;
+
+    if (block_size - need >= MALLOC_MIN_BLOCK) {
+        set_tags(off + need, block_size - need, 0);
+        list_insert(off + need, block_size - need);
+    } else {
+        need = block_size;
+        heap->free_blocks--;
+    }
+    set_tags(off, need, MALLOC_TAG_USED);
+    LIVE_WORD(off) |= LIVE_BIT(off);
+    heap->free_bytes -= need;
+    heap->used_blocks++;
+    return (uint8_t *) (HEAP_START + off + 4);
+}
+
+/* Function: heap_free
+ * Inputs: ptr - a pointer returned by heap_alloc, or NULL
+ * Return Value: 0 on success, -1 if ptr is not an allocated block
+ * Description: Merges the block with whichever neighbours are free, found
+ *              through the header after it and the footer before it. The
+ *              block's own tags are cleared first, so none of a merged
+ *              block's old tags still reads as allocated
+ */
+int32_t heap_free(uint8_t *ptr){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t off, tag, size, freed, next_tag, prev_tag, neighbour;
+
+    if (!ptr)
+        return 0;
+    if ((uint32_t) ptr < HEAP_START + 4 || !heap->ready)
+        return -1;
+    off = (uint32_t) ptr - HEAP_START - 4;
+    // Only the start of a block that is allocated now; the tags alone
+    // could be user data, or left over from a block since merged away
+    if (!block_in_heap(off) || !(LIVE_WORD(off) & LIVE_BIT(off)))
+        return -1;
+    tag = HEAP_WORD(off);
+    size = TAG_SIZE(tag);
+    if (!(tag & MALLOC_TAG_USED) || size < MALLOC_MIN_BLOCK
+            || off + size > BLOCKS_END || HEAP_WORD(off + size - 4) != tag)
+        return -1;
+    freed = size;
+    LIVE_WORD(off) &= ~LIVE_BIT(off);
+    set_tags(off, size, 0);
+
+    if (off + size < BLOCKS_END) {
+        next_tag = HEAP_WORD(off + size);
+        neighbour = TAG_SIZE(next_tag);
+        if (!(next_tag & MALLOC_TAG_USED) && neighbour >= MALLOC_MIN_BLOCK
+                && off + size + neighbour <= BLOCKS_END
+                && list_remove(off + size, neighbour) == 0) {
+            size += neighbour;
+            heap->free_blocks--;
+        }
+    }
+    if (off > FIRST_BLOCK) {
+        prev_tag = HEAP_WORD(off - 4);
+        neighbour = TAG_SIZE(prev_tag);
+        if (!(prev_tag & MALLOC_TAG_USED) && neighbour >= MALLOC_MIN_BLOCK
+                && neighbour <= off - FIRST_BLOCK
+                && list_remove(off - neighbour, neighbour) == 0) {
+            off -= neighbour;
+            size += neighbour;
+            heap->free_blocks--;
+        }
+    }
+
+    set_tags(off, size, 0);
+    list_insert(off, size);
+    heap->free_bytes += freed;
+    heap->used_blocks--;
+    heap->free_blocks++;
+    return 0;
+}
+
+/* Function: heap_get_stats
+ * Inputs: stats - where to copy the calling task's heap usage
+ * Return Value: none
+ */
+void heap_get_stats(malloc_stats_t *stats){
+    malloc_heap_t *heap = HEAP_MAP;
+    uint32_t off, size, steps;
+
+    if (!heap->ready)
+        heap_init();
+
+    stats->heap_size = BLOCKS_END - FIRST_BLOCK;
+    stats->free_bytes = heap->free_bytes;
+    stats->used_blocks = heap->used_blocks;
+    stats->free_blocks = heap->free_blocks;
+    stats->largest_free = 0;
+    if (!heap->class_map)
+        return;
+
+    // The biggest block is on the highest non-empty list
+    off = heap->free_lists[bit_high(heap->class_map)];
+    for (steps = 0; steps < heap->free_blocks && block_in_heap(off); steps++) {
+        size = TAG_SIZE(HEAP_WORD(off));
+        if (size >= MALLOC_MIN_BLOCK && size - MALLOC_TAGS_SIZE > stats->largest_free)
+            stats->largest_free = size - MALLOC_TAGS_SIZE;
+        off = BLOCK_NEXT(off);
+    }
+}
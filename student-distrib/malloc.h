@@ -0,0 +1,67 @@
+#ifndef _MALLOC_H
+#define _MALLOC_H
+
+#include "types.h"
+#include "page.h"
+
+/* Per-task heap behind syscall_malloc / syscall_free. Free blocks sit on
+ * segregated lists, one per power of two size, and every block carries its
+ * size in a header and a footer (boundary tags) so that freeing can merge
+ * with both neighbours without a search. Allocating and freeing are O(1).
+ *
+ * Everything lives in the task's own memory: the list heads in the page at
+ * MALLOC_HEAP_MAP_START and the blocks right after it. Both are demand-zero
+ * pages, and an all-zero map means the heap has not been set up yet, so
+ * execute has nothing to do. The task can scribble over all of it, so the
+ * kernel bounds every offset it follows */
+
+#define MALLOC_MAP_SIZE         PAGE_SIZE
+#define MALLOC_HEAP_SIZE        (256 * 1024)
+#define MALLOC_HEAP_MAP_START   TASK_VIRT_PAGE_BEG
+#define HEAP_START              (MALLOC_HEAP_MAP_START + MALLOC_MAP_SIZE)
+#define HEAP_END                (HEAP_START + MALLOC_HEAP_SIZE)
+
+// Payloads are 8 byte aligned; block sizes are multiples of this
+#define MALLOC_ALIGN            8
+// Header and footer, one word each
+#define MALLOC_TAGS_SIZE        8
+// Tags plus the free list links
+#define MALLOC_MIN_BLOCK        16
+#define MALLOC_MIN_SHIFT        4
+// One list for each power of two from MALLOC_MIN_BLOCK up to the heap size
+#define MALLOC_CLASS_NUM        15
+// Terminates the free lists
+#define MALLOC_NIL              0xFFFFFFFF
+// Set in a block's tags while it is allocated
+#define MALLOC_TAG_USED         0x1
+// Blocks are at least MALLOC_MIN_BLOCK apart, so each slot of that size
+// holds at most one block start; one bit per slot marks the allocated ones
+#define MALLOC_LIVE_WORDS       (MALLOC_HEAP_SIZE / MALLOC_MIN_BLOCK / 32)
+
+typedef struct {
+    uint32_t heap_size;
+    uint32_t free_bytes;        // includes the tags of free blocks
+    uint32_t largest_free;      // biggest request that can succeed
+    uint32_t used_blocks;
+    uint32_t free_blocks;
+} malloc_stats_t;
+
+/* Lives at MALLOC_HEAP_MAP_START. Blocks are named by their offset from
+ * HEAP_START */
+typedef struct {
+    uint32_t ready;                             // 0 until the first malloc
+    uint32_t class_map;                         // bit k: free_lists[k] is not empty
+    uint32_t free_lists[MALLOC_CLASS_NUM];
+    uint32_t free_bytes;
+    uint32_t used_blocks;
+    uint32_t free_blocks;
+    // Bit off / MALLOC_MIN_BLOCK: an allocated block starts at off, so free
+    // only takes pointers heap_alloc handed out and hasn't had back
+    uint32_t live[MALLOC_LIVE_WORDS];
+} malloc_heap_t;
+
+uint8_t *heap_alloc(uint32_t size);
+int32_t heap_free(uint8_t *ptr);
+void heap_get_stats(malloc_stats_t *stats);
+
+#endif
@@ -10,6 +10,9 @@
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
 
+/* Check if the bit BIT in FLAGS is set. */
+#define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
+
 #ifndef ASM
 
 /* Types */
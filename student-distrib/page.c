@@ -1,15 +1,37 @@
 #include "page.h"
 #include "lib.h"
 #include "x86_desc.h"
+#include "task.h"
+#include "multiboot.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "kdata.h"
 
 /* global arrays for the page directory and page table */
 PDE_t __attribute__((aligned (4096))) page_directory[MAX_ENTRIES];
 PTE_t __attribute__((aligned (4096))) vidmem_page_table[MAX_ENTRIES];
-PTE_t __attribute__((aligned (4096))) user_vidmem_page_table[MAX_ENTRIES];
+/* one per CPU, since what it shows depends on the task running there */
+static PTE_t __attribute__((aligned (4096))) user_vidmem_page_table[SMP_MAX_CPUS][MAX_ENTRIES];
+/* stands in for the per-task user and mmap tables until the first execute;
+ * tasks get their own tables from the frame allocator */
+PTE_t __attribute__((aligned (4096))) empty_page_table[MAX_ENTRIES];
+
+/* one bit per 4 KB physical frame below FRAME_MEM_END, set if the frame is
+ * in use or isn't RAM */
+static uint32_t frame_bitmap[FRAME_NUM / 32];
+/* number of page table entries sharing each allocated frame after fork */
+static uint8_t frame_refs[FRAME_NUM];
+static uint32_t frame_total;
+static uint32_t frame_free_count;
+/* where the next single frame search starts */
+static uint32_t frame_hint;
+/* frames are allocated and freed outside the kernel lock, e.g. when a
+ * dead task's memory is released after the switch away from it */
+static spinlock_t frame_lock = SPINLOCK_INIT;
 
 void init_page(void){
     /* for loop indices */
-    int i, j;
+    int i, j, cpu;
 
     /* For details of the default page values, refer to IA-32 page 3-25 */
 
@@ -50,10 +72,12 @@ void init_page(void){
       if(i == VID_MEM_ADDR || i == BACKGROUND_1 || i == BACKGROUND_2 || i == BACKGROUND_3){
         vidmem_page_table[i].present = 0x1;
         vidmem_page_table[i].user_super = 0x1;
+        vidmem_page_table[i].global = 0x1;
       }
       else{
         vidmem_page_table[i].present = 0x0;
         vidmem_page_table[i].user_super = 0x0;
+        vidmem_page_table[i].global = 0x0;
       }
       vidmem_page_table[i].read_write = 0x1;
       vidmem_page_table[i].pwt = 0x0;
@@ -61,31 +85,45 @@ void init_page(void){
       vidmem_page_table[i].accessed = 0x0;
       vidmem_page_table[i].dirty = 0x0;
       vidmem_page_table[i].pat = 0x0;
-      vidmem_page_table[i].global = 0x0;
       vidmem_page_table[i].available = 0x0;
       vidmem_page_table[i].page_addr = i;
     }
 
-    for(i = 0; i < MAX_ENTRIES; i++){
-      /* if the current mapping is to the Video memory
-      * then mark present, else mark it unpresent */
-      user_vidmem_page_table[i].read_write = 0x1;
-      user_vidmem_page_table[i].pwt = 0x0;
-      user_vidmem_page_table[i].pcd = 0x0;
-      user_vidmem_page_table[i].accessed = 0x0;
-      user_vidmem_page_table[i].dirty = 0x0;
-      user_vidmem_page_table[i].pat = 0x0;
-      user_vidmem_page_table[i].global = 0x0;
-      user_vidmem_page_table[i].available = 0x0;
-      user_vidmem_page_table[i].page_addr = i;
-      if(i == 0){
-        user_vidmem_page_table[i].present = 0x1;
-        user_vidmem_page_table[i].user_super = 0x1;
-        user_vidmem_page_table[i].page_addr = VID_MEM_ADDR;
-      }
-      else{
-        user_vidmem_page_table[i].present = 0x0;
-        user_vidmem_page_table[i].user_super = 0x0;
+    for(cpu = 0; cpu < SMP_MAX_CPUS; cpu++){
+      PTE_t *table = user_vidmem_page_table[cpu];
+      for(i = 0; i < MAX_ENTRIES; i++){
+        /* if the current mapping is to the Video memory
+        * then mark present, else mark it unpresent */
+        table[i].read_write = 0x1;
+        table[i].pwt = 0x0;
+        table[i].pcd = 0x0;
+        table[i].accessed = 0x0;
+        table[i].dirty = 0x0;
+        table[i].pat = 0x0;
+        table[i].global = 0x0;
+        table[i].available = 0x0;
+        table[i].page_addr = i;
+        if(i == 0){
+          table[i].present = 0x1;
+          table[i].user_super = 0x1;
+          table[i].page_addr = VID_MEM_ADDR;
+        }
+        else if(i == PAGE_TABLE_INDEX(TASK_KDATA_START)){
+          table[i].present = 0x1;
+          table[i].read_write = 0x0;
+          table[i].user_super = 0x1;
+          table[i].page_addr = (uint32_t)&kdata_page >> ADDRESS_SHIFT;
+        }
+        else if(i == PAGE_TABLE_INDEX(TASK_KDATA_CPU_START)){
+          table[i].present = 0x1;
+          table[i].read_write = 0x0;
+          table[i].user_super = 0x1;
+          table[i].page_addr = (uint32_t)&kdata_cpu_pages[cpu] >> ADDRESS_SHIFT;
+        }
+        else{
+          table[i].present = 0x0;
+          table[i].user_super = 0x0;
+        }
       }
     }
 
@@ -106,20 +144,26 @@ void init_page(void){
       page_directory[j].page_PDE.page_addr = 0x0;
     }
 
-    // Reserve a user page table entry so we can set it directly later
-    page_directory[USER_PAGE_INDEX].page_PDE.present = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.read_write = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.user_super = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.pwt = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.pcd = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.accessed = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.dirty = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_size = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.global = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.available = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.pat = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.reserved = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = USER_PAGE_INDEX;
+    /* Identity map the frame allocator's memory for the kernel only */
+    for(j = KERNEL_MAP_FIRST_INDEX; j < KERNEL_MAP_LAST_INDEX; j++){
+      page_directory[j].page_PDE.present = 0x1;
+      page_directory[j].page_PDE.global = 0x1;
+      page_directory[j].page_PDE.page_addr = j;
+    }
+
+    // Tasks get a copy of this directory with their own user and mmap
+    // tables; the kernel's boot context keeps the empty ones
+    page_directory[USER_PAGE_INDEX].table_PDE.present = 0x1;
+    page_directory[USER_PAGE_INDEX].table_PDE.read_write = 0x1;
+    page_directory[USER_PAGE_INDEX].table_PDE.user_super = 0x1;
+    page_directory[USER_PAGE_INDEX].table_PDE.pwt = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.pcd = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.accessed = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.page_size = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.global = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.available = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.reserved = 0x0;
+    page_directory[USER_PAGE_INDEX].table_PDE.table_addr = (uint32_t)empty_page_table >> ADDRESS_SHIFT;
 
     page_directory[USER_VIDMEM_INDEX].table_PDE.present = 0x1;
     page_directory[USER_VIDMEM_INDEX].table_PDE.read_write = 0x1;
@@ -131,17 +175,33 @@ void init_page(void){
     page_directory[USER_VIDMEM_INDEX].table_PDE.global = 0x0;
     page_directory[USER_VIDMEM_INDEX].table_PDE.available = 0x0;
     page_directory[USER_VIDMEM_INDEX].table_PDE.reserved = 0x0;
-    page_directory[USER_VIDMEM_INDEX].table_PDE.table_addr = (uint32_t)user_vidmem_page_table >> ADDRESS_SHIFT;
+    page_directory[USER_VIDMEM_INDEX].table_PDE.table_addr = (uint32_t)user_vidmem_page_table[0] >> ADDRESS_SHIFT;
+
+    /* The mmap table is swapped per task; access rights are per page */
+    page_directory[USER_MMAP_INDEX].table_PDE.present = 0x1;
+    page_directory[USER_MMAP_INDEX].table_PDE.read_write = 0x1;
+    page_directory[USER_MMAP_INDEX].table_PDE.user_super = 0x1;
+    page_directory[USER_MMAP_INDEX].table_PDE.pwt = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.pcd = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.accessed = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.page_size = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.global = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.available = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.reserved = 0x0;
+    page_directory[USER_MMAP_INDEX].table_PDE.table_addr = (uint32_t)empty_page_table >> ADDRESS_SHIFT;
 
-    /* Enable paging and 4MB pages */
+    /* Enable paging, 4MB pages and global pages, so the kernel's entries
+     * stay in the TLB when CR3 is switched between tasks; CR0.WP makes
+     * read-only user pages read-only for the kernel too, so a syscall
+     * can't write through an mmap'ed file page */
     asm volatile(
       " movl %0, %%eax; "
       " movl %%eax, %%cr3; "
       " movl %%cr4, %%eax; "
-      " orl $0x00000010, %%eax; "
+      " orl $0x00000090, %%eax; "
       " movl %%eax, %%cr4; "
       " movl %%cr0, %%eax; "
-      " orl $0x80000001, %%eax; "
+      " orl $0x80010001, %%eax; "
       " movl %%eax, %%cr0; "
       :
       : "r"(page_directory)
@@ -149,3 +209,416 @@ void init_page(void){
     );
 
 }
+
+/* page_setup_dir
+ *  Description: Fills in a task's page directory: the kernel's global
+ *      mappings and user video memory are copied from the boot directory,
+ *      the user and mmap tables are the task's own
+ *  Arg:
+ *      dir: the task's page directory frame
+ *      user_table: the task's user page table
+ *      mmap_table: the task's mmap page table
+ */
+void page_setup_dir(PDE_t *dir, PTE_t *user_table, PTE_t *mmap_table) {
+    memcpy(dir, page_directory, MAX_ENTRIES * sizeof(PDE_t));
+    dir[USER_PAGE_INDEX].table_PDE.table_addr = (uint32_t)user_table >> ADDRESS_SHIFT;
+    dir[USER_MMAP_INDEX].table_PDE.table_addr = (uint32_t)mmap_table >> ADDRESS_SHIFT;
+}
+
+/* page_switch_task
+ *  Description: Loads a task's page directory. The kernel's entries are
+ *      global and survive the CR3 write; only user entries are flushed
+ *  Arg:
+ *      dir: the task's page directory
+ */
+void page_switch_task(PDE_t *dir) {
+    uint32_t cur_dir;
+    asm volatile ("movl %%cr3, %0;" : "=r" (cur_dir));
+    if (cur_dir == (uint32_t)dir) {
+        return;
+    }
+    asm volatile(
+        " movl %0, %%cr3; "
+        :
+        : "r"(dir)
+        : "memory"
+    );
+}
+
+/* page_set_user_vidmem
+ *  Description: Points the task's user video memory at this CPU's table,
+ *      and that table's page at the screen if the task's terminal is the
+ *      visible one, or at the terminal's background page otherwise; drops
+ *      the old translation if anything changed
+ *  Arg:
+ *      dir: page directory of the task that is about to run
+ *      cpu: index of the CPU it runs on
+ *      term_ind: its terminal
+ *      visible: 1 if that terminal is on screen
+ */
+void page_set_user_vidmem(PDE_t *dir, uint8_t cpu, uint8_t term_ind, uint8_t visible) {
+    PTE_t *table = user_vidmem_page_table[cpu];
+    uint32_t page = visible ? VID_MEM_ADDR : BACKGROUND_1 + term_ind;
+    uint32_t table_addr = (uint32_t) table >> ADDRESS_SHIFT;
+    if (table[0].page_addr == page && dir[USER_VIDMEM_INDEX].table_PDE.table_addr == table_addr) {
+        return;
+    }
+    dir[USER_VIDMEM_INDEX].table_PDE.table_addr = table_addr;
+    table[0].page_addr = page;
+    flush_tlb_page(TASK_VIDMEM_START);
+}
+
+/* page_map_uncached
+ *  Description: Maps the 4 MB around a device's registers, at the same
+ *      address, for the kernel only and with caching off. Tasks copy the
+ *      boot directory, so this has to happen before the first execute
+ *  Arg:
+ *      phys_addr: physical address of the registers
+ */
+void page_map_uncached(uint32_t phys_addr) {
+    uint32_t i = phys_addr >> PAGE_TABLE_ADDR_SHIFT;
+    page_directory[i].page_PDE.present = 0x1;
+    page_directory[i].page_PDE.pwt = 0x1;
+    page_directory[i].page_PDE.pcd = 0x1;
+    page_directory[i].page_PDE.global = 0x1;
+    page_directory[i].page_PDE.page_addr = i;
+}
+
+/* page_map_low
+ *  Description: Identity maps a 4 KB page below 4 MB for the kernel, or
+ *      takes the mapping away again
+ *  Arg:
+ *      phys_addr: address inside the page
+ *      present: 1 to map it, 0 to unmap it
+ */
+void page_map_low(uint32_t phys_addr, uint8_t present) {
+    PTE_t *pte = &vidmem_page_table[phys_addr >> ADDRESS_SHIFT];
+    pte->present = present;
+    pte->user_super = 0x0;
+    pte->global = 0x0;
+    pte->page_addr = phys_addr >> ADDRESS_SHIFT;
+    flush_tlb_page(phys_addr);
+}
+
+/* page_setup_task
+ *  Description: Clears a task's user page table. Every page starts out not
+ *      present and gets a frame on first touch; pages in
+ *      [lazy_start, lazy_end) are marked PTE_AVAIL_LAZY so the page fault
+ *      handler fills them in from the program image instead of zeroing them
+ *  Arg:
+ *      user_table: the task's user page table
+ *      lazy_start: first user address of the image
+ *      lazy_end: end of the image (not page aligned)
+ */
+void page_setup_task(PTE_t *user_table, uint32_t lazy_start, uint32_t lazy_end) {
+    uint32_t i;
+    uint32_t lazy_first = (lazy_start - TASK_VIRT_PAGE_BEG) >> ADDRESS_SHIFT;
+    uint32_t lazy_last = (lazy_end - TASK_VIRT_PAGE_BEG + PAGE_SIZE - 1) >> ADDRESS_SHIFT;
+
+    if (lazy_last > MAX_ENTRIES) {
+        lazy_last = MAX_ENTRIES;
+    }
+
+    memset(user_table, 0, MAX_ENTRIES * sizeof(PTE_t));
+    for (i = lazy_first; i < lazy_last; i++) {
+        user_table[i].available = PTE_AVAIL_LAZY;
+    }
+}
+
+/* page_release_task
+ *  Description: Returns every frame mapped in a task's user page table
+ *  Arg:
+ *      user_table: the task's user page table
+ */
+void page_release_task(PTE_t *user_table) {
+    uint32_t i;
+
+    for (i = 0; i < MAX_ENTRIES; i++) {
+        if (user_table[i].present) {
+            frame_free(user_table[i].page_addr << ADDRESS_SHIFT);
+            clear_pte(&user_table[i]);
+        }
+    }
+}
+
+/* page_fork_task
+ *  Description: Shares a task's user pages with a child copy-on-write.
+ *      Writable pages become read-only and PTE_AVAIL_COW in both tables
+ *      and their frames gain a reference; pages not faulted in yet are
+ *      copied as they are. The caller flushes the parent's TLB
+ *  Arg:
+ *      child_table: the child's user page table
+ *      parent_table: the parent's user page table
+ */
+void page_fork_task(PTE_t *child_table, PTE_t *parent_table) {
+    uint32_t i;
+
+    for (i = 0; i < MAX_ENTRIES; i++) {
+        if (parent_table[i].present) {
+            if (parent_table[i].read_write) {
+                parent_table[i].read_write = 0x0;
+                parent_table[i].available = PTE_AVAIL_COW;
+            }
+            frame_ref(parent_table[i].page_addr << ADDRESS_SHIFT);
+        }
+        child_table[i] = parent_table[i];
+    }
+}
+
+/* flush_tlb_user
+ *  Description: Drops every non-global entry from the TLB by reloading CR3
+ */
+void flush_tlb_user(void) {
+    asm volatile (
+        " movl %%cr3, %%eax; "
+        " movl %%eax, %%cr3; "
+        :
+        :
+        : "eax", "memory"
+    );
+}
+
+/* frame_mark
+ *  Description: Marks the whole frames inside [start, end) free or used,
+ *      ignoring anything outside the allocator's range
+ *  Arg:
+ *      start, end: physical byte range
+ *      used: 1 to reserve the frames, 0 to free them
+ */
+static void frame_mark(uint32_t start, uint32_t end, uint8_t used) {
+    uint32_t frame;
+
+    if (start < FRAME_MEM_START) {
+        start = FRAME_MEM_START;
+    }
+    if (end > FRAME_MEM_END) {
+        end = FRAME_MEM_END;
+    }
+    /* Free only frames entirely inside the range, reserve any it touches */
+    if (used) {
+        start &= ~(PAGE_SIZE - 1);
+        end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    } else {
+        start = (start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        end &= ~(PAGE_SIZE - 1);
+    }
+
+    for (frame = start >> ADDRESS_SHIFT; frame < end >> ADDRESS_SHIFT; frame++) {
+        if (used && !BITMAP_TEST(frame_bitmap, frame)) {
+            BITMAP_SET(frame_bitmap, frame);
+            frame_free_count--;
+            frame_total--;
+        } else if (!used && BITMAP_TEST(frame_bitmap, frame)) {
+            BITMAP_CLEAR(frame_bitmap, frame);
+            frame_free_count++;
+            frame_total++;
+        }
+    }
+}
+
+/* frame_init
+ *  Description: Seeds the frame allocator with the RAM listed in the
+ *      multiboot memory map (or mem_upper if there is no map), minus the
+ *      boot modules
+ *  Arg:
+ *      mbi_addr: address of the multiboot info structure
+ */
+void frame_init(uint32_t mbi_addr) {
+    multiboot_info_t *mbi = (multiboot_info_t *) mbi_addr;
+    uint32_t i;
+
+    memset(frame_bitmap, 0xFF, sizeof(frame_bitmap));
+    frame_total = 0;
+    frame_free_count = 0;
+    frame_hint = FRAME_MEM_START >> ADDRESS_SHIFT;
+
+    if (CHECK_FLAG(mbi->flags, 6)) {
+        memory_map_t *mmap = (memory_map_t *) mbi->mmap_addr;
+        while ((uint32_t) mmap < mbi->mmap_addr + mbi->mmap_length) {
+            /* Type 1 is usable RAM; anything past 4 GB is out of reach */
+            if (mmap->type == 1 && !mmap->base_addr_high) {
+                uint32_t end = mmap->base_addr_low + mmap->length_low;
+                if (mmap->length_high || end < mmap->base_addr_low) {
+                    end = FRAME_MEM_END;
+                }
+                frame_mark(mmap->base_addr_low, end, 0);
+            }
+            mmap = (memory_map_t *) ((uint32_t) mmap + mmap->size + sizeof(mmap->size));
+        }
+    } else if (CHECK_FLAG(mbi->flags, 0)) {
+        /* mem_upper is the KB of memory starting at 1 MB */
+        frame_mark(0x100000, 0x100000 + mbi->mem_upper * 1024, 0);
+    }
+
+    if (CHECK_FLAG(mbi->flags, 3)) {
+        module_t *mod = (module_t *) mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++) {
+            frame_mark(mod->mod_start, mod->mod_end, 1);
+        }
+    }
+}
+
+/* frame_alloc
+ *  Description: Allocates one 4 KB physical frame
+ *  RETURN: physical address of the frame, or 0 if memory is exhausted
+ */
+uint32_t frame_alloc(void) {
+    return frame_alloc_aligned(1);
+}
+
+/* frame_alloc_aligned
+ *  Description: Allocates a run of contiguous frames aligned to the size
+ *      of the run, e.g. two frames on an 8 KB boundary for a kernel stack
+ *  Arg:
+ *      count: number of frames; must be a power of 2
+ *  RETURN: physical address of the first frame, or 0 if there is no such run
+ */
+uint32_t frame_alloc_aligned(uint32_t count) {
+    uint32_t first = FRAME_MEM_START >> ADDRESS_SHIFT;
+    uint32_t start, frame, i, tried, flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    if (frame_free_count < count) {
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return 0;
+    }
+    start = frame_hint & ~(count - 1);
+    if (start < first) {
+        start = first;
+    }
+
+    frame = start;
+    for (tried = 0; tried < FRAME_NUM; tried += count, frame += count) {
+        if (frame + count > FRAME_NUM) {
+            frame = first;
+        }
+        /* Skip whole words of used frames when looking for a single one */
+        if (count == 1 && !(frame & 0x1F) && frame_bitmap[frame >> 5] == 0xFFFFFFFF) {
+            frame += 31;
+            tried += 31;
+            continue;
+        }
+        for (i = 0; i < count && !BITMAP_TEST(frame_bitmap, frame + i); i++);
+        if (i == count) {
+            for (i = 0; i < count; i++) {
+                BITMAP_SET(frame_bitmap, frame + i);
+                frame_refs[frame + i] = 1;
+            }
+            frame_free_count -= count;
+            if (count == 1) {
+                frame_hint = frame + 1;
+            }
+            spin_unlock_irqrestore(&frame_lock, flags);
+            return frame << ADDRESS_SHIFT;
+        }
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return 0;
+}
+
+/* frame_free
+ *  Description: Returns a frame from frame_alloc to the allocator
+ *  Arg:
+ *      phys_addr: physical address of the frame
+ */
+void frame_free(uint32_t phys_addr) {
+    frame_free_range(phys_addr, 1);
+}
+
+/* frame_free_range
+ *  Description: Drops a reference to each frame in a run, returning the
+ *      ones nobody else shares to the allocator
+ *  Arg:
+ *      phys_addr: physical address of the first frame
+ *      count: number of frames
+ */
+void frame_free_range(uint32_t phys_addr, uint32_t count) {
+    uint32_t frame = phys_addr >> ADDRESS_SHIFT;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    for (; count > 0; count--, frame++) {
+        if (frame >= FRAME_NUM || !BITMAP_TEST(frame_bitmap, frame)) {
+            continue;
+        }
+        if (frame_refs[frame] > 1) {
+            frame_refs[frame]--;
+            continue;
+        }
+        frame_refs[frame] = 0;
+        BITMAP_CLEAR(frame_bitmap, frame);
+        frame_free_count++;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/* frame_ref
+ *  Description: Adds a reference to an allocated frame that is about to be
+ *      shared; frame_free then only drops the reference
+ *  Arg:
+ *      phys_addr: physical address of the frame
+ */
+void frame_ref(uint32_t phys_addr) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    frame_refs[phys_addr >> ADDRESS_SHIFT]++;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/* frame_refcount
+ *  Description: Number of references to an allocated frame
+ */
+uint32_t frame_refcount(uint32_t phys_addr) {
+    return frame_refs[phys_addr >> ADDRESS_SHIFT];
+}
+
+/* frame_get_stats
+ *  Description: Copies out the frame allocator's counters
+ */
+void frame_get_stats(frame_stats_t *stats) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    stats->total = frame_total;
+    stats->free = frame_free_count;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/* set_pte
+ *  Description: Points a 4 KB page table entry at a physical page
+ *  Arg:
+ *      pte: the entry to fill in
+ *      phys_addr: 4 KB aligned physical address
+ *      user: 1 if the page is reachable from ring 3
+ *      writable: 1 if the page can be written
+ */
+void set_pte(PTE_t *pte, uint32_t phys_addr, uint8_t user, uint8_t writable) {
+    pte->read_write = writable;
+    pte->user_super = user;
+    pte->pwt = 0x0;
+    pte->pcd = 0x0;
+    pte->accessed = 0x0;
+    pte->dirty = 0x0;
+    pte->pat = 0x0;
+    pte->global = 0x0;
+    pte->available = 0x0;
+    pte->page_addr = phys_addr >> ADDRESS_SHIFT;
+    pte->present = 0x1;
+}
+
+/* clear_pte
+ *  Description: Marks a 4 KB page table entry not present
+ */
+void clear_pte(PTE_t *pte) {
+    *(uint32_t *) pte = 0;
+}
+
+/* flush_tlb_page
+ *  Description: Drops a single page from the TLB
+ *  Arg:
+ *      virt_addr: any address inside the page
+ */
+void flush_tlb_page(uint32_t virt_addr) {
+    asm volatile ("invlpg (%0)" : : "r"(virt_addr) : "memory");
+}
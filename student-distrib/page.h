@@ -14,10 +14,40 @@
 #define TASK_VIRT_PAGE_BEG 0x8000000
 #define TASK_VIRT_PAGE_END 0x8400000
 #define TASK_VIDMEM_START  0x8800000
+// Read-only kernel data after video memory, one page shared by every task
+// and one for the CPU the task runs on (see kdata.h)
+#define TASK_KDATA_START     (TASK_VIDMEM_START + PAGE_SIZE)
+#define TASK_KDATA_CPU_START (TASK_VIDMEM_START + 2 * PAGE_SIZE)
+// 4 KB mappings of file data made by mmap
+#define TASK_MMAP_START    0x8C00000
+#define TASK_MMAP_END      0x9000000
 // 4 MB = 4 * 1024 * 1024
 #define PAGE_TABLE_ADDR_SHIFT (2 + 10 + 10)
 #define USER_PAGE_INDEX (TASK_VIRT_PAGE_BEG >> PAGE_TABLE_ADDR_SHIFT)
 #define USER_VIDMEM_INDEX (TASK_VIDMEM_START >> PAGE_TABLE_ADDR_SHIFT)
+#define USER_MMAP_INDEX (TASK_MMAP_START >> PAGE_TABLE_ADDR_SHIFT)
+// Index of a 4 KB page inside its page table
+#define PAGE_TABLE_INDEX(addr) (((addr) >> ADDRESS_SHIFT) & (MAX_ENTRIES - 1))
+// Set in the available bits of a not-present user page that gets its
+// contents from the task's image on first touch
+#define PTE_AVAIL_LAZY 0x1
+// Set in the available bits of a read-only user page whose frame is shared
+// with a forked task until one of them writes to it
+#define PTE_AVAIL_COW  0x2
+
+// Physical frames handed out by the frame allocator. The kernel reaches
+// them through a supervisor-only identity map of this range, which has to
+// stay below the user region at 128 MB
+#define FRAME_MEM_START   0x800000
+#define FRAME_MEM_END     TASK_VIRT_PAGE_BEG
+#define FRAME_NUM         (FRAME_MEM_END >> ADDRESS_SHIFT)
+#define KERNEL_MAP_FIRST_INDEX (FRAME_MEM_START >> PAGE_TABLE_ADDR_SHIFT)
+#define KERNEL_MAP_LAST_INDEX  (FRAME_MEM_END >> PAGE_TABLE_ADDR_SHIFT)
+
+typedef struct {
+    uint32_t total;     // frames seeded from the memory map
+    uint32_t free;
+} frame_stats_t;
 
 /* Structure for a page table entry */
 typedef struct __attribute__ ((packed)) PTE_t{
@@ -69,9 +99,35 @@ typedef union PDE_t {
 
 /* initializes the page directory and enables paging */
 void init_page(void);
+/* per-task page directories */
+void page_setup_dir(PDE_t *dir, PTE_t *user_table, PTE_t *mmap_table);
+void page_switch_task(PDE_t *dir);
+void page_set_user_vidmem(PDE_t *dir, uint8_t cpu, uint8_t term_ind, uint8_t visible);
+/* kernel-only mappings for devices and the AP trampoline */
+void page_map_uncached(uint32_t phys_addr);
+void page_map_low(uint32_t phys_addr, uint8_t present);
+/* clears the task's user table, marking the image range to be faulted in */
+void page_setup_task(PTE_t *user_table, uint32_t lazy_start, uint32_t lazy_end);
+/* frees every user frame mapped in the table */
+void page_release_task(PTE_t *user_table);
+/* shares the user pages with a forked child copy-on-write */
+void page_fork_task(PTE_t *child_table, PTE_t *parent_table);
+/* physical frame allocator */
+void frame_init(uint32_t mbi_addr);
+uint32_t frame_alloc(void);
+uint32_t frame_alloc_aligned(uint32_t count);
+void frame_free(uint32_t phys_addr);
+void frame_free_range(uint32_t phys_addr, uint32_t count);
+void frame_ref(uint32_t phys_addr);
+uint32_t frame_refcount(uint32_t phys_addr);
+void frame_get_stats(frame_stats_t *stats);
+/* 4 KB page table helpers */
+void set_pte(PTE_t *pte, uint32_t phys_addr, uint8_t user, uint8_t writable);
+void clear_pte(PTE_t *pte);
+void flush_tlb_page(uint32_t virt_addr);
+void flush_tlb_user(void);
 
 PDE_t page_directory[MAX_ENTRIES];
 PTE_t vidmem_page_table[MAX_ENTRIES];
-PTE_t user_vidmem_page_table[MAX_ENTRIES];
 
 #endif
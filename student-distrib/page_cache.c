@@ -0,0 +1,207 @@
+#include "page_cache.h"
+#include "file_sys.h"
+#include "lib.h"
+
+/* Cached page contents and their bookkeeping */
+static uint8_t __attribute__((aligned (4096))) cache_pages[PAGE_CACHE_PAGES][PAGE_CACHE_PAGE_SIZE];
+static page_cache_entry_t cache_entries[PAGE_CACHE_PAGES];
+static uint16_t cache_buckets[PAGE_CACHE_BUCKETS];
+/* Head is the most recently used entry, tail the next one to evict */
+static uint16_t lru_head, lru_tail;
+static page_cache_stats_t cache_stats;
+
+/* Function: cache_bucket
+ * Inputs: inode - the file's inode number
+ *         page_index - the page number inside the file
+ * Return Value: the hash bucket for the key
+ */
+static uint32_t cache_bucket(int32_t inode, uint32_t page_index){
+    return ((uint32_t)inode * 31 + page_index) & (PAGE_CACHE_BUCKETS - 1);
+}
+
+/* Function: lru_unlink
+ * Inputs: i - the entry to take out of the LRU list
+ */
+static void lru_unlink(uint16_t i){
+    page_cache_entry_t* ent = &cache_entries[i];
+    if(ent->lru_prev != PAGE_CACHE_NONE)
+      cache_entries[ent->lru_prev].lru_next = ent->lru_next;
+    else
+      lru_head = ent->lru_next;
+    if(ent->lru_next != PAGE_CACHE_NONE)
+      cache_entries[ent->lru_next].lru_prev = ent->lru_prev;
+    else
+      lru_tail = ent->lru_prev;
+}
+
+/* Function: lru_push_head
+ * Inputs: i - the entry to mark as most recently used
+ */
+static void lru_push_head(uint16_t i){
+    page_cache_entry_t* ent = &cache_entries[i];
+    ent->lru_prev = PAGE_CACHE_NONE;
+    ent->lru_next = lru_head;
+    if(lru_head != PAGE_CACHE_NONE)
+      cache_entries[lru_head].lru_prev = i;
+    lru_head = i;
+    if(lru_tail == PAGE_CACHE_NONE)
+      lru_tail = i;
+}
+
+/* Function: lru_push_tail
+ * Inputs: i - the entry to mark as the first to be evicted
+ */
+static void lru_push_tail(uint16_t i){
+    page_cache_entry_t* ent = &cache_entries[i];
+    ent->lru_next = PAGE_CACHE_NONE;
+    ent->lru_prev = lru_tail;
+    if(lru_tail != PAGE_CACHE_NONE)
+      cache_entries[lru_tail].lru_next = i;
+    lru_tail = i;
+    if(lru_head == PAGE_CACHE_NONE)
+      lru_head = i;
+}
+
+/* Function: hash_unlink
+ * Inputs: i - the entry to take out of its hash chain
+ */
+static void hash_unlink(uint16_t i){
+    uint16_t* link = &cache_buckets[cache_bucket(cache_entries[i].inode, cache_entries[i].page_index)];
+    while(*link != PAGE_CACHE_NONE){
+      if(*link == i){
+        *link = cache_entries[i].hash_next;
+        return;
+      }
+      link = &cache_entries[*link].hash_next;
+    }
+}
+
+/* Function: cache_lookup
+ * Inputs: inode - the file's inode number
+ *         page_index - the page number inside the file
+ * Return Value: the entry holding the page, or PAGE_CACHE_NONE
+ */
+static uint16_t cache_lookup(int32_t inode, uint32_t page_index){
+    uint16_t i;
+    for(i = cache_buckets[cache_bucket(inode, page_index)]; i != PAGE_CACHE_NONE; i = cache_entries[i].hash_next){
+      if(cache_entries[i].inode == inode && cache_entries[i].page_index == page_index)
+        return i;
+    }
+    return PAGE_CACHE_NONE;
+}
+
+/* Function: cache_fill
+ * Inputs: inode - the file's inode number
+ *         page_index - the page number inside the file
+ * Return Value: the entry now holding the page
+ * Function: Evicts the least recently used entry and reads the page into it
+ */
+static uint16_t cache_fill(int32_t inode, uint32_t page_index){
+    uint16_t i = lru_tail;
+    page_cache_entry_t* ent = &cache_entries[i];
+
+    if(ent->inode != -1){
+      hash_unlink(i);
+      cache_stats.evictions++;
+    }
+
+    ent->inode = inode;
+    ent->page_index = page_index;
+    ent->valid = read_data(inode, page_index * PAGE_CACHE_PAGE_SIZE, (int8_t*)cache_pages[i], PAGE_CACHE_PAGE_SIZE);
+
+    ent->hash_next = cache_buckets[cache_bucket(inode, page_index)];
+    cache_buckets[cache_bucket(inode, page_index)] = i;
+    return i;
+}
+
+/* Function: page_cache_init
+ * Inputs: None
+ * Return Value: None
+ * Function: Empties the cache; every entry starts out on the LRU list
+ */
+void page_cache_init(void){
+    uint16_t i;
+
+    for(i = 0; i < PAGE_CACHE_BUCKETS; i++)
+      cache_buckets[i] = PAGE_CACHE_NONE;
+
+    lru_head = lru_tail = PAGE_CACHE_NONE;
+    for(i = 0; i < PAGE_CACHE_PAGES; i++){
+      cache_entries[i].inode = -1;
+      cache_entries[i].hash_next = PAGE_CACHE_NONE;
+      lru_push_tail(i);
+    }
+
+    cache_stats.hits = cache_stats.misses = cache_stats.evictions = 0;
+}
+
+/* Function: page_cache_read
+ * Inputs: inode - the file's inode number
+ *         offset - the number of bytes already read
+ *         buf - the buffer we want to copy data to
+ *         length - the number of bytes we want to read
+ * Return Value: The number of bytes read
+ * Function: Same contract as read_data(), but served from cached pages
+ */
+int32_t page_cache_read(int32_t inode, uint32_t offset, int8_t* buf, uint32_t length){
+    uint32_t num_bytes = 0;
+    uint32_t page_off, run_len;
+    uint16_t i;
+
+    while(num_bytes < length){
+      uint32_t page_index = offset / PAGE_CACHE_PAGE_SIZE;
+      page_off = offset % PAGE_CACHE_PAGE_SIZE;
+
+      if((i = cache_lookup(inode, page_index)) != PAGE_CACHE_NONE){
+        cache_stats.hits++;
+      } else {
+        cache_stats.misses++;
+        i = cache_fill(inode, page_index);
+      }
+      lru_unlink(i);
+      lru_push_head(i);
+
+      /* past the end of the file */
+      if(page_off >= cache_entries[i].valid)
+        break;
+
+      run_len = cache_entries[i].valid - page_off;
+      if(run_len > length - num_bytes)
+        run_len = length - num_bytes;
+      memcpy(buf + num_bytes, cache_pages[i] + page_off, run_len);
+
+      num_bytes += run_len;
+      offset += run_len;
+      /* a short page is the last page of the file */
+      if(cache_entries[i].valid < PAGE_CACHE_PAGE_SIZE)
+        break;
+    }
+
+    return (int32_t)num_bytes;
+}
+
+/* Function: page_cache_invalidate
+ * Inputs: inode - the file's inode number
+ *         page_index - the page number inside the file
+ * Return Value: None
+ * Function: Drops a page whose backing data changed; the entry becomes
+ *           the next one to be reused
+ */
+void page_cache_invalidate(int32_t inode, uint32_t page_index){
+    uint16_t i = cache_lookup(inode, page_index);
+    if(i == PAGE_CACHE_NONE)
+      return;
+
+    hash_unlink(i);
+    cache_entries[i].inode = -1;
+    lru_unlink(i);
+    lru_push_tail(i);
+}
+
+/* Function: page_cache_get_stats
+ * Inputs: stats - where to copy the counters to
+ * Return Value: None
+ */
+void page_cache_get_stats(page_cache_stats_t* stats){
+    *stats = cache_stats;
+}
@@ -0,0 +1,35 @@
+#ifndef _PAGE_CACHE_H
+#define _PAGE_CACHE_H
+
+#include "types.h"
+
+/* Page cache for file data, keyed by (inode, page index). Everything that
+ * reads file contents goes through here, so the backing store behind
+ * read_data() is only touched on a miss */
+
+#define PAGE_CACHE_PAGES        64
+#define PAGE_CACHE_BUCKETS      64
+#define PAGE_CACHE_PAGE_SIZE    0x1000
+#define PAGE_CACHE_NONE         0xFFFF
+
+typedef struct page_cache_stats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} page_cache_stats_t;
+
+typedef struct page_cache_entry {
+    int32_t inode;              // -1 if the entry holds no page
+    uint32_t page_index;
+    uint32_t valid;             // Number of bytes of file data in the page
+    uint16_t lru_prev;          // Towards the most recently used entry
+    uint16_t lru_next;          // Towards the least recently used entry
+    uint16_t hash_next;
+} page_cache_entry_t;
+
+void page_cache_init(void);
+int32_t page_cache_read(int32_t inode, uint32_t offset, int8_t* buf, uint32_t length);
+void page_cache_invalidate(int32_t inode, uint32_t page_index);
+void page_cache_get_stats(page_cache_stats_t* stats);
+
+#endif
@@ -0,0 +1,289 @@
+#include "pipe.h"
+#include "lib.h"
+#include "page.h"
+#include "scheduling.h"
+#include "io_ring.h"
+
+static int32_t pipe_read_invalid(int8_t *buf, uint32_t nbytes, FILE *file) {
+    return -1;
+}
+
+static int32_t pipe_write_invalid(const int8_t *buf, uint32_t nbytes, FILE *file) {
+    return -1;
+}
+
+file_ops_table_t pipe_read_ops_table = {
+    .open = NULL,
+    .read = pipe_read,
+    .write = pipe_write_invalid,
+    .close = pipe_close,
+    .poll = pipe_poll,
+};
+
+file_ops_table_t pipe_write_ops_table = {
+    .open = NULL,
+    .read = pipe_read_invalid,
+    .write = pipe_write,
+    .close = pipe_close,
+    .poll = pipe_poll,
+};
+
+#define FILE_PIPE(file) ((pipe_t *) (file)->inode)
+
+/* pipe_create
+ *  Descrption: Makes an empty pipe and fills in a descriptor for each end
+ *  Arg:
+ *      read_end: unused descriptor to read from the pipe with
+ *      write_end: unused descriptor to write to it with
+ *
+ * 	RETURN:
+ *      0 on success, -1 if there is no free frame
+ */
+int32_t pipe_create(FILE *read_end, FILE *write_end) {
+    pipe_t *pipe = (pipe_t *) frame_alloc();
+
+    if (!pipe) {
+        return -1;
+    }
+    memset(&pipe->hdr, 0, sizeof(pipe_header_t));
+    pipe->hdr.readers = 1;
+    pipe->hdr.writers = 1;
+
+    read_end->file_ops = &pipe_read_ops_table;
+    read_end->inode = (int32_t) pipe;
+    read_end->pos = 0;
+    read_end->flags.type = TASK_FILE_PIPE;
+    *write_end = *read_end;
+    write_end->file_ops = &pipe_write_ops_table;
+    return 0;
+}
+
+/* pipe_dup
+ *  Descrption: Counts one more descriptor on the same end, for a copy of
+ *      file that has just been made
+ *  Arg:
+ *      file: either end
+ */
+void pipe_dup(FILE *file) {
+    pipe_t *pipe = FILE_PIPE(file);
+    uint32_t flags;
+
+    spin_lock_irqsave(&pipe->hdr.lock, flags);
+    if (file->file_ops == &pipe_read_ops_table) {
+        pipe->hdr.readers++;
+    } else {
+        pipe->hdr.writers++;
+    }
+    spin_unlock_irqrestore(&pipe->hdr.lock, flags);
+}
+
+/* pipe_take
+ *  Descrption: Moves up to len bytes out of the pipe, wrapping at the end
+ *      of the buffer. Called with the lock held
+ *
+ * 	RETURN:
+ *      bytes moved
+ */
+static uint32_t pipe_take(pipe_t *pipe, uint8_t *dst, uint32_t len) {
+    pipe_header_t *hdr = &pipe->hdr;
+    uint32_t chunk, n, done = 0;
+
+    n = len < hdr->count ? len : hdr->count;
+    // At most two pieces: up to the end of the buffer, then from the start
+    while (done < n) {
+        chunk = PIPE_BUF_SIZE - hdr->rpos;
+        if (chunk > n - done) {
+            chunk = n - done;
+        }
+        memcpy(dst + done, pipe->buf + hdr->rpos, chunk);
+        hdr->rpos = (hdr->rpos + chunk) % PIPE_BUF_SIZE;
+        hdr->count -= chunk;
+        done += chunk;
+    }
+    return n;
+}
+
+/* pipe_put
+ *  Descrption: Moves as much of len bytes into the pipe as there is room
+ *      for. Called with the lock held
+ *
+ * 	RETURN:
+ *      bytes moved
+ */
+static uint32_t pipe_put(pipe_t *pipe, const uint8_t *src, uint32_t len) {
+    pipe_header_t *hdr = &pipe->hdr;
+    uint32_t wpos, chunk, done = 0;
+
+    while (done < len && hdr->count < PIPE_BUF_SIZE) {
+        wpos = (hdr->rpos + hdr->count) % PIPE_BUF_SIZE;
+        // Free space runs up to the data if the data wraps, or else to the
+        // end of the buffer
+        if (wpos < hdr->rpos) {
+            chunk = hdr->rpos - wpos;
+        } else {
+            chunk = PIPE_BUF_SIZE - wpos;
+        }
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        memcpy(pipe->buf + wpos, src + done, chunk);
+        hdr->count += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+/* pipe_read
+ *  Descrption: Sleeps until the pipe has data or no writers, then takes
+ *      what is there, up to nbytes
+ *  Arg:
+ *      buf: where the data goes
+ *      nbytes: most bytes to take
+ *      file: the read end
+ *
+ * 	RETURN:
+ *      bytes read, 0 at end of file, or SYSCALL_WOULD_BLOCK for a
+ *      non-blocking descriptor and an empty pipe
+ */
+int32_t pipe_read(int8_t *buf, uint32_t nbytes, FILE *file) {
+    pipe_t *pipe = FILE_PIPE(file);
+    pipe_header_t *hdr = &pipe->hdr;
+    uint8_t chunk[PIPE_CHUNK];
+    uint32_t flags, n, done = 0;
+
+    if (!buf) {
+        return -1;
+    }
+    spin_lock_irqsave(&hdr->lock, flags);
+    while (!hdr->count && hdr->writers) {
+        if (file->flags.nonblock) {
+            spin_unlock_irqrestore(&hdr->lock, flags);
+            return SYSCALL_WOULD_BLOCK;
+        }
+        sched_sleep(&hdr->read_wq, &hdr->lock);
+    }
+    // Whatever is there by the time each chunk is taken, without waiting
+    // for more
+    while (done < nbytes && hdr->count) {
+        n = pipe_take(pipe, chunk, nbytes - done < PIPE_CHUNK ? nbytes - done : PIPE_CHUNK);
+        sched_wake_all(&hdr->write_wq);
+        spin_unlock_irqrestore(&hdr->lock, flags);
+        io_notify();
+        memcpy(buf + done, chunk, n);
+        done += n;
+        spin_lock_irqsave(&hdr->lock, flags);
+    }
+    spin_unlock_irqrestore(&hdr->lock, flags);
+    return done;
+}
+
+/* pipe_write
+ *  Descrption: Copies all of buf into the pipe, sleeping whenever it is
+ *      full until a reader makes room
+ *  Arg:
+ *      buf: the data
+ *      nbytes: its length
+ *      file: the write end
+ *
+ * 	RETURN:
+ *      nbytes, or -1 if there are no readers left; whatever went in
+ *      before the last reader closed stays written. A non-blocking
+ *      descriptor stops when the pipe is full, with the bytes written so
+ *      far or SYSCALL_WOULD_BLOCK if there were none
+ */
+int32_t pipe_write(const int8_t *buf, uint32_t nbytes, FILE *file) {
+    pipe_t *pipe = FILE_PIPE(file);
+    pipe_header_t *hdr = &pipe->hdr;
+    uint8_t chunk[PIPE_CHUNK];
+    uint32_t flags, n, sent, done = 0;
+
+    if (!buf) {
+        return -1;
+    }
+    while (done < nbytes) {
+        n = nbytes - done < PIPE_CHUNK ? nbytes - done : PIPE_CHUNK;
+        memcpy(chunk, buf + done, n);
+        spin_lock_irqsave(&hdr->lock, flags);
+        for (sent = 0; sent < n; ) {
+            while (hdr->count == PIPE_BUF_SIZE && hdr->readers) {
+                if (file->flags.nonblock) {
+                    spin_unlock_irqrestore(&hdr->lock, flags);
+                    if (!(done += sent)) {
+                        return SYSCALL_WOULD_BLOCK;
+                    }
+                    io_notify();
+                    return done;
+                }
+                sched_sleep(&hdr->write_wq, &hdr->lock);
+            }
+            if (!hdr->readers) {
+                spin_unlock_irqrestore(&hdr->lock, flags);
+                return -1;
+            }
+            sent += pipe_put(pipe, chunk + sent, n - sent);
+            // Let a reader start on it while the rest waits for room
+            sched_wake_all(&hdr->read_wq);
+        }
+        spin_unlock_irqrestore(&hdr->lock, flags);
+        io_notify();
+        done += n;
+    }
+    return nbytes;
+}
+
+/* pipe_close
+ *  Descrption: Drops one descriptor on an end; waiters on the other end
+ *      may now get end of file or an error. The last close frees the pipe
+ *  Arg:
+ *      file: either end
+ *
+ * 	RETURN:
+ *      0
+ */
+int32_t pipe_close(FILE *file) {
+    pipe_t *pipe = FILE_PIPE(file);
+    pipe_header_t *hdr = &pipe->hdr;
+    uint32_t flags, left;
+
+    spin_lock_irqsave(&hdr->lock, flags);
+    if (file->file_ops == &pipe_read_ops_table) {
+        hdr->readers--;
+    } else {
+        hdr->writers--;
+    }
+    left = hdr->readers + hdr->writers;
+    sched_wake_all(&hdr->read_wq);
+    sched_wake_all(&hdr->write_wq);
+    spin_unlock_irqrestore(&hdr->lock, flags);
+    io_notify();
+    if (!left) {
+        frame_free((uint32_t) pipe);
+    }
+    return 0;
+}
+
+/* pipe_poll
+ *  Descrption: A read won't sleep if there is data or nobody left to write
+ *      any; a write won't if there is room or nobody left to read it
+ *  Arg:
+ *      file: either end
+ *
+ * 	RETURN:
+ *      POLL_IN for a read end that is ready, POLL_OUT for a write end
+ */
+int32_t pipe_poll(FILE *file) {
+    pipe_header_t *hdr = &FILE_PIPE(file)->hdr;
+    uint32_t flags;
+    int32_t ready = 0;
+
+    spin_lock_irqsave(&hdr->lock, flags);
+    if (file->file_ops == &pipe_read_ops_table) {
+        if (hdr->count || !hdr->writers) {
+            ready = POLL_IN;
+        }
+    } else if (hdr->count < PIPE_BUF_SIZE || !hdr->readers) {
+        ready = POLL_OUT;
+    }
+    spin_unlock_irqrestore(&hdr->lock, flags);
+    return ready;
+}
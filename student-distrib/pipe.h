@@ -0,0 +1,46 @@
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "task.h"
+#include "spinlock.h"
+
+/* A pipe is a byte ring in one frame, with a read end and a write end that
+ * tasks get as descriptors from syscall_pipe. Each end counts the
+ * descriptors open on it, through fork, execute and dup2; a reader gets
+ * end of file once every write end is closed, and a writer gets -1 once
+ * every read end is */
+
+typedef struct {
+    spinlock_t lock;
+    // Readers waiting for data, writers waiting for room
+    wait_queue_t read_wq;
+    wait_queue_t write_wq;
+    // Bytes waiting, starting at rpos
+    uint32_t rpos;
+    uint32_t count;
+    uint32_t readers;
+    uint32_t writers;
+} pipe_header_t;
+
+#define PIPE_BUF_SIZE (PAGE_SIZE - sizeof(pipe_header_t))
+// Most bytes moved per trip through the lock. The task's buffer is copied
+// to or from a chunk on the kernel stack with the lock dropped, since
+// touching it may fault
+#define PIPE_CHUNK 256
+
+typedef struct {
+    pipe_header_t hdr;
+    uint8_t buf[PIPE_BUF_SIZE];
+} pipe_t;
+
+file_ops_table_t pipe_read_ops_table, pipe_write_ops_table;
+
+int32_t pipe_create(FILE *read_end, FILE *write_end);
+void pipe_dup(FILE *file);
+int32_t pipe_read(int8_t *buf, uint32_t nbytes, FILE *file);
+int32_t pipe_write(const int8_t *buf, uint32_t nbytes, FILE *file);
+int32_t pipe_close(FILE *file);
+int32_t pipe_poll(FILE *file);
+
+#endif /* _PIPE_H */
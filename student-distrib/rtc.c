@@ -6,22 +6,31 @@
 #include "i8259.h"
 #include "task.h"
 #include "syscall.h"
+#include "scheduling.h"
+#include "kdata.h"
+#include "io_ring.h"
 
 #define RTC_SYS_START_FREQ 2
 
-static FILE *rtc_files[MAX_PROC_NUM] = {NULL};
+static FILE *rtc_files[RTC_MAX_FILES] = {NULL};
+/* Readers asleep until the matching file's next virtual tick */
+static wait_queue_t rtc_wqs[RTC_MAX_FILES];
+/* Guards rtc_files, the wait queues and the counters in each file against
+ * rtc_isr running on another CPU */
+static spinlock_t rtc_lock = SPINLOCK_INIT;
 
 file_ops_table_t rtc_file_ops_table = {
     .open = rtc_open,
     .read = rtc_read,
     .write = rtc_write,
     .close = rtc_close,
+    .poll = rtc_poll,
 };
 
 
 /* RTC driver
  * The users RTC is virtualized. Also, the maximum number of user RTC that a system
- * can keep track of is limited by `MAX_PROC_NUM`.
+ * can keep track of is limited by `RTC_MAX_FILES`.
  *
  * Before using RTC, the system must call init_rtc() to initialize.
  *
@@ -110,7 +119,7 @@ file_ops_table_t rtc_file_ops_table = {
 // So we make these counter count up to 81920, and take different step under different freq.
 // The equation for step is (8192/sys freq)
 #define SYS_COUNTER_MAX (RTC_SYS_MAX_FREQ*10)
-int32_t time_elasped[MAX_PROC_NUM] = {0};
+int32_t time_elasped[RTC_MAX_FILES] = {0};
 int32_t sys_counter_step;
 
 
@@ -134,6 +143,9 @@ void init_rtc(void) {
 	// Enable IRQs
 	enable_irq(RTC_IRQ);
 	enable_irq(SLAVE_PIC_IRQ);
+	// Off the boot CPU, which takes the keyboard and starts the shells,
+	// when the I/O APIC can send it elsewhere
+	irq_set_affinity(RTC_IRQ, smp_cpu_count - 1);
 
 	// Init routine from https://wiki.osdev.org/RTC
 	// Enable interrupt
@@ -187,6 +199,7 @@ void reset_rtc_info( FILE *file, int32_t freq_pow ){
  * 	RETURN:
  * 		-1 if failed
  * 		0  if sucess
+ *	The caller holds rtc_lock.
  *	reference :https://github.com/torvalds/linux/blob/master/drivers/char/rtc.c
  */
 int32_t rtc_set_pi_freq(int32_t freq){
@@ -208,7 +221,6 @@ int32_t rtc_set_pi_freq(int32_t freq){
 	rtc_rate_val = 16 - freq_pow; // 8192 is the 2 to the power of 16.
 
 	// set frequency
-	cli();
 	sys_freq_pow=freq_pow;
 	sys_freq = 1<<sys_freq_pow;
 	sys_counter_step = RTC_SYS_MAX_FREQ>>sys_freq_pow;
@@ -217,12 +229,11 @@ int32_t rtc_set_pi_freq(int32_t freq){
 	prev = inb(RTC_DATA_PORT);				// get initial value of register A
 	outb(RTC_FREQ_SELECT, RTC_ADDR_PORT);	// reset index to A
 	outb((prev & 0xF0) | (rtc_rate_val&0xF), RTC_DATA_PORT);        //write only our rate to A. Note, rate is the bottom 4 bits.
-	sti();
 
 	// check and update all rtc field
 	int i=0;
 	FILE *rtc;
-	for( i=0;i<MAX_PROC_NUM;i++){
+	for( i=0;i<RTC_MAX_FILES;i++){
 	  if( (rtc=rtc_files[i]) ){
 			reset_rtc_info(rtc, get_rtc_freq(rtc->inode));
 	  }
@@ -256,6 +267,8 @@ int32_t rtc_write(const int8_t *buf, uint32_t length, FILE *file){
 	if (freq != (1<<freq_pow))
 		return -1;
 
+	uint32_t flags;
+	spin_lock_irqsave(&rtc_lock, flags);
 	if(freq > sys_freq ){
 		set_rtc_freq_field(file->inode, freq_pow);
 		
@@ -264,6 +277,7 @@ int32_t rtc_write(const int8_t *buf, uint32_t length, FILE *file){
 	}else{
 		reset_rtc_info(file,freq_pow);
 	}
+	spin_unlock_irqrestore(&rtc_lock, flags);
 	return 0;
 }
 
@@ -276,9 +290,10 @@ int32_t rtc_write(const int8_t *buf, uint32_t length, FILE *file){
 void rtc_isr(void) {
 	outb(0x0C, RTC_ADDR_PORT);
 	(void) inb(RTC_DATA_PORT);
-	uint8_t i;
+	uint8_t i, fired = 0;
 	int count ;
-	for (i = 0; i < MAX_PROC_NUM; i ++) {
+	spin_lock(&rtc_lock);
+	for (i = 0; i < RTC_MAX_FILES; i ++) {
 		time_elasped[i] += sys_counter_step;
 		if (time_elasped[i] >= SYS_COUNTER_MAX){
 			time_elasped[i] = 0;
@@ -296,40 +311,77 @@ void rtc_isr(void) {
 				 	count = 32;
 				}
 				set_rtc_count_field(cur_file->inode, count );
+				sched_wake_all(&rtc_wqs[i]);
+				fired = 1;
 			}
 		}
 	}
+	kdata_rtc_tick(sys_freq);
+	spin_unlock(&rtc_lock);
+	if (fired)
+		io_notify();
 }
 
 /* rtc_read
  *	Descrption:	a user blocking function intended to wait for the next RTC interrupt.
+ *		The task sleeps until rtc_isr wakes it instead of spinning.
  *	Args:
  *		buf: (not used) Use NULL in this argument
  *		length: (not used) Use 0 in this argument
  *		file: RTC file descriptor
- * 	RETURN: none
+ * 	RETURN: 0, or SYSCALL_WOULD_BLOCK if no tick is waiting and the
+ *		descriptor is non-blocking
   */
 int32_t rtc_read(int8_t* buf, uint32_t length, FILE *file){
 	int count;
-	sti();
+	uint8_t i;
+	uint32_t flags;
+	// The lock is held from the check to the sleep
+	spin_lock_irqsave(&rtc_lock, flags);
+	for (i = 0; i < RTC_MAX_FILES && rtc_files[i] != file; i ++);
+	if (i == RTC_MAX_FILES) {
+		spin_unlock_irqrestore(&rtc_lock, flags);
+		return -1;
+	}
 	while( (count=get_rtc_count(file->inode)) == 0 ){
-		asm volatile ("hlt");
+		if (file->flags.nonblock) {
+			spin_unlock_irqrestore(&rtc_lock, flags);
+			return SYSCALL_WOULD_BLOCK;
+		}
+		sched_sleep(&rtc_wqs[i], &rtc_lock);
 	}
-	cli();
 	if( count >=1 ){
 		count -= 1;
 		set_rtc_count_field(file->inode, count);
 	}
+	spin_unlock_irqrestore(&rtc_lock, flags);
 	return 0;
 }
 
+/* rtc_poll
+ *	Descrption:	whether a read would return without waiting: a tick has
+ *		been counted that no read has taken yet. Writes never wait
+ *	Args:
+ *		file: RTC file descriptor
+ * 	RETURN: POLL_IN if a tick is waiting, and POLL_OUT
+  */
+int32_t rtc_poll(FILE *file){
+	uint32_t flags;
+	int32_t ready = POLL_OUT;
+	spin_lock_irqsave(&rtc_lock, flags);
+	if (get_rtc_count(file->inode))
+		ready |= POLL_IN;
+	spin_unlock_irqrestore(&rtc_lock, flags);
+	return ready;
+}
+
 /* rtc_open
  *	Descrption:	open a rtc descriptor for a process.
  *	Args:
  *		filename: (not used) use "" in this argument.
  *		file: pointer to the RTC file descriptor
  * 	RETURN: 0 if success
-		halt the system if too many RTC is opend in this system.
+		-1 if too many RTC are opened in this system.
   */
 int32_t rtc_open(const int8_t *filename, FILE *file){
 	int freq_pow;
@@ -343,20 +395,24 @@ int32_t rtc_open(const int8_t *filename, FILE *file){
 	if ( usr_freq != (1<<freq_pow))
 		return -1;
 
+	uint32_t flags;
+	spin_lock_irqsave(&rtc_lock, flags);
 	reset_rtc_info(file,freq_pow);
 	file->file_ops = &rtc_file_ops_table;
 	file->flags.type = TASK_FILE_RTC;
 
 	uint8_t i;
-	for (i = 0; i < MAX_PROC_NUM; i ++) {
+	for (i = 0; i < RTC_MAX_FILES; i ++) {
 		if (!rtc_files[i]) {
 			rtc_files[i] = file;
 			time_elasped[i] = 0;
+			spin_unlock_irqrestore(&rtc_lock, flags);
 			return 0;
 		}
 	}
 
-	while (1) { asm volatile ("hlt;"); } 	// UNREACHABLE!!!
+	spin_unlock_irqrestore(&rtc_lock, flags);
+	return -1;
 }
 
 /* rtc_close
@@ -370,20 +426,24 @@ int32_t rtc_close(FILE *file){
 	uint8_t i;
 	uint32_t max_i = -1;
 	uint32_t max_freq = -1;
-	for (i = 0; i < MAX_PROC_NUM; i ++) {
+	uint32_t flags;
+	int32_t ret = 0;
+	spin_lock_irqsave(&rtc_lock, flags);
+	for (i = 0; i < RTC_MAX_FILES; i ++) {
 		if (rtc_files[i] == file) {
 			rtc_files[i] = NULL;
 		}
 	}
 	uint32_t tmp_freq;
-	for( i=0 ; i<MAX_PROC_NUM ; i++){
+	for( i=0 ; i<RTC_MAX_FILES ; i++){
 		if( rtc_files[i] && (tmp_freq=get_rtc_freq(rtc_files[i]->inode))>max_freq){
 			max_freq = tmp_freq;
 			max_i = i;
 		}
 	}
 	if(max_i!=-1){
-		return rtc_set_pi_freq( max_freq);
+		ret = rtc_set_pi_freq( max_freq);
 	}
-	return 0;
+	spin_unlock_irqrestore(&rtc_lock, flags);
+	return ret;
 }
@@ -31,6 +31,8 @@
 
 #define RTC_USER_MAX_FREQ 1024
 #define RTC_USER_DEF_FREQ 2
+// Number of RTC descriptors open at once across all tasks
+#define RTC_MAX_FILES 10
 
 
 file_ops_table_t rtc_file_ops_table;
@@ -44,6 +46,7 @@ int32_t rtc_open(const int8_t *filename, FILE *file);
 int32_t rtc_read(int8_t* buf, uint32_t length, FILE *file);
 int32_t rtc_write(const int8_t* buf, uint32_t length, FILE *file);
 int32_t rtc_close(FILE *file);
+int32_t rtc_poll(FILE *file);
 
 
 #endif
@@ -3,12 +3,257 @@
 #include "idt.h"
 #include "x86_desc.h"
 #include "term.h"
+#include "fpu.h"
+#include "apic.h"
+#include "kdata.h"
+
+/* Everything here runs with interrupts off, so the run queue locks only
+ * keep the other CPUs out. A task is on the queue of task->cpu, the CPU
+ * it last ran on, and is only moved when an idle CPU steals it */
+static sched_rq_t run_queues[SMP_MAX_CPUS];
+#define this_rq() (&run_queues[this_cpu()->id])
+
+/* Periodic while tasks run on any CPU; the boot CPU's idle loop turns it
+ * into a one-shot timer or stops it. Stopped for good when the local APIC
+ * timers tick instead, each CPU's kept in cpu->tick_state */
+static uint8_t pit_state;
+/* PIT ticks until the MLFQ policy next raises every task */
+static uint32_t mlfq_boost_left = SCHED_MLFQ_BOOST;
+/* Counts the boosts; a task whose sched_boost_gen is behind is raised the
+ * next time the policy looks at it */
+static volatile uint32_t mlfq_boost_gen;
+
+/* void rq_push_tail;
+ * Inputs: rq - a run queue
+ *         task - a task not on any run queue
+ * Return Value: None
+ */
+static void rq_push_tail(sched_rq_t* rq, PCB_t* task){
+    task->rq_next = NULL;
+    task->rq_prev = rq->tail;
+    if(rq->tail)
+        rq->tail->rq_next = task;
+    else
+        rq->head = task;
+    rq->tail = task;
+}
+
+/* void rq_remove;
+ * Inputs: rq - a run queue
+ *         task - a task on it
+ * Return Value: None
+ */
+static void rq_remove(sched_rq_t* rq, PCB_t* task){
+    if(task->rq_prev)
+        task->rq_prev->rq_next = task->rq_next;
+    else
+        rq->head = task->rq_next;
+    if(task->rq_next)
+        task->rq_next->rq_prev = task->rq_prev;
+    else
+        rq->tail = task->rq_prev;
+}
+
+/* PCB_t* rr_pick_next;
+ * Return Value: the task that has been waiting the longest
+ */
+static PCB_t* rr_pick_next(sched_rq_t* rq){
+    PCB_t* task = rq->head;
+    if(task)
+        rq_remove(rq, task);
+    return task;
+}
+
+/* uint32_t rr_time_slice;
+ * Return Value: the same slice for every task
+ */
+static uint32_t rr_time_slice(PCB_t* task){
+    return SCHED_RR_SLICE;
+}
+
+/* void fair_enqueue;
+ * Inputs: task - a task becoming runnable
+ * Return Value: None
+ * Function: A task that has not run in a while (or at all) starts level
+ *           with the others instead of owning the CPU until it catches up
+ */
+static void fair_enqueue(sched_rq_t* rq, PCB_t* task){
+    if(task->sched_key < rq->fair_min_key)
+        task->sched_key = rq->fair_min_key;
+    rq_push_tail(rq, task);
+}
+
+/* PCB_t* fair_pick_next;
+ * Return Value: the task that has had the least CPU time
+ */
+static PCB_t* fair_pick_next(sched_rq_t* rq){
+    PCB_t *task, *best = rq->head;
+
+    if(!best)
+        return NULL;
+    for(task = best->rq_next; task; task = task->rq_next){
+        if(task->sched_key < best->sched_key)
+            best = task;
+    }
+    rq_remove(rq, best);
+    rq->fair_min_key = best->sched_key;
+    return best;
+}
+
+/* void fair_tick;
+ * Inputs: task - the running task
+ * Return Value: None
+ */
+static void fair_tick(PCB_t* task){
+    task->sched_key++;
+}
+
+/* uint32_t fair_time_slice;
+ * Return Value: a short slice, so the least-run task is picked often
+ */
+static uint32_t fair_time_slice(PCB_t* task){
+    return SCHED_FAIR_SLICE;
+}
+
+/* void mlfq_catch_up;
+ * Inputs: task - the running task, or one on the run queue being looked at
+ * Return Value: None
+ * Function: Applies any boost the task has missed
+ */
+static void mlfq_catch_up(PCB_t* task){
+    uint32_t gen = mlfq_boost_gen;
+
+    if(task->sched_boost_gen != gen){
+        task->sched_boost_gen = gen;
+        task->sched_level = task->nice;
+    }
+}
+
+/* PCB_t* mlfq_pick_next;
+ * Return Value: the task that has been waiting the longest on the highest
+ *               non-empty level
+ */
+static PCB_t* mlfq_pick_next(sched_rq_t* rq){
+    PCB_t *task, *best = rq->head;
+
+    if(!best)
+        return NULL;
+    mlfq_catch_up(best);
+    for(task = best->rq_next; task; task = task->rq_next){
+        mlfq_catch_up(task);
+        if(task->sched_level < best->sched_level)
+            best = task;
+    }
+    rq_remove(rq, best);
+    return best;
+}
+
+/* void mlfq_tick;
+ * Inputs: task - the running task
+ * Return Value: None
+ * Function: Every SCHED_MLFQ_BOOST ticks puts every task back on its base
+ *           level, so CPU hogs demoted to the bottom still get to run.
+ *           Called from the timer interrupt with no lock, while other CPUs
+ *           may be freeing tasks, so it touches no task but its own: other
+ *           tasks catch up when pick_next looks at them under their run
+ *           queue's lock
+ */
+static void mlfq_tick(PCB_t* task){
+    uint8_t expired;
+
+    /* Counted in the ticks tasks run for on any CPU */
+    asm volatile ("lock decl %0; setz %1"
+            : "+m" (mlfq_boost_left), "=q" (expired) : : "memory", "cc");
+    if(expired){
+        mlfq_boost_left = SCHED_MLFQ_BOOST;
+        asm volatile ("lock incl %0" : "+m" (mlfq_boost_gen) : : "memory", "cc");
+    }
+    mlfq_catch_up(task);
+}
+
+/* void mlfq_expire;
+ * Inputs: task - a task that ran for its whole slice
+ * Return Value: None
+ * Function: Moves the task down a level, where slices are longer but it
+ *           only runs when nothing above it wants to
+ */
+static void mlfq_expire(PCB_t* task){
+    mlfq_catch_up(task);
+    if(task->sched_level < SCHED_MLFQ_LEVELS - 1)
+        task->sched_level++;
+}
+
+/* void mlfq_boost;
+ * Inputs: task - a task going to sleep until the user types
+ * Return Value: None
+ * Function: Interactive tasks go back up to their base level, so they run
+ *           ahead of the CPU hogs as soon as the key comes in
+ */
+static void mlfq_boost(PCB_t* task){
+    task->sched_level = task->nice;
+}
+
+/* uint32_t mlfq_time_slice;
+ * Return Value: a slice that doubles with every level down
+ */
+static uint32_t mlfq_time_slice(PCB_t* task){
+    return 1 << task->sched_level;
+}
+
+static sched_policy_t sched_policies[SCHED_POLICY_NUM] = {
+    [SCHED_RR] = {
+        .name = "rr",
+        .enqueue = rq_push_tail,
+        .dequeue = rq_remove,
+        .pick_next = rr_pick_next,
+        .tick = NULL,
+        .expire = NULL,
+        .boost = NULL,
+        .time_slice = rr_time_slice,
+    },
+    [SCHED_FAIR] = {
+        .name = "fair",
+        .enqueue = fair_enqueue,
+        .dequeue = rq_remove,
+        .pick_next = fair_pick_next,
+        .tick = fair_tick,
+        .expire = NULL,
+        .boost = NULL,
+        .time_slice = fair_time_slice,
+    },
+    [SCHED_MLFQ] = {
+        .name = "mlfq",
+        .enqueue = rq_push_tail,
+        .dequeue = rq_remove,
+        .pick_next = mlfq_pick_next,
+        .tick = mlfq_tick,
+        .expire = mlfq_expire,
+        .boost = mlfq_boost,
+        .time_slice = mlfq_time_slice,
+    },
+};
+static int32_t sched_policy_ind = SCHED_RR;
+static sched_policy_t* sched_policy = &sched_policies[SCHED_RR];
+
+/* void pit_program;
+ * Inputs: mode - PIT_MODE3 or PIT_MODE0
+ *         count - PIT input clocks per interrupt
+ * Return Value: None
+ */
+static void pit_program(uint8_t mode, uint32_t count){
+    outb(mode, PIT_CMD_REG);
+    // Set low bits
+    outb(count & 0xFF, PIT_DATA0_PORT);
+    // Set high bits
+    outb(count >> 8, PIT_DATA0_PORT);
+}
 
 /* void init_pit;
  * Inputs: None
  * Return Value: None
  * Function: Initializes interrupt support for the PIT and sets the
- * timer interval to 30ms
+ * timer interval to one scheduler tick, unless the local APIC timers
+ * give the ticks
  */
 void init_pit(){
 
@@ -16,80 +261,658 @@ void init_pit(){
     SET_IDT_ENTRY(idt[PIT_INT], _pit_isr);
     idt[PIT_INT].present = 1;
 
-    // Calculate 30 millisecond timer interrupt
-    int32_t set_30MS = CLOCK_TICK_RATE / _33HZ_DIV;
+    if(apic_timer_count){
+        outb(PIT_MODE0, PIT_CMD_REG);
+        pit_state = PIT_STOPPED;
+        return;
+    }
+
     // Set pit mode to a square wave
-    outb(PIT_MODE3, PIT_CMD_REG);
-    // Set low bits
-    outb(set_30MS & 0xFF, PIT_DATA0_PORT);
-    // Set high bits
-    outb(set_30MS >> 8, PIT_DATA0_PORT);
+    pit_program(PIT_MODE3, PIT_DIV);
+    pit_state = PIT_PERIODIC;
 
     enable_irq(PIT_IRQNUM);
 }
 
+/* void pit_busy;
+ * Inputs: None
+ * Return Value: None
+ * Function: Goes back to periodic ticks before a task runs, so it can be
+ *           preempted and charged for its time
+ */
+static void pit_busy(void){
+    if(pit_state == PIT_PERIODIC)
+        return;
+    pit_program(PIT_MODE3, PIT_DIV);
+    pit_state = PIT_PERIODIC;
+}
+
+/* void tick_busy;
+ * Inputs: cpu - this CPU, about to run a task
+ * Return Value: None
+ * Function: Makes sure this CPU gets ticks while the task runs
+ */
+static void tick_busy(cpu_t* cpu){
+    if(apic_timer_count){
+        if(cpu->tick_state != PIT_PERIODIC){
+            lapic_timer_start(apic_timer_count, 1);
+            cpu->tick_state = PIT_PERIODIC;
+        }
+    } else if(!cpu->id){
+        pit_busy();
+    } else if(!cpu->busy){
+        /* The boot CPU may have stopped the PIT, which it only checks
+         * before halting */
+        cpu->busy = 1;
+        smp_mb();
+        smp_kick_idle(0);
+    }
+}
+
+/* uint32_t sched_next_deadline;
+ * Inputs: None
+ * Return Value: PIT ticks until something needs the timer while nothing is
+ *               runnable, or 0 if nothing does
+ * Function: Runnable tasks are woken by their own interrupts, so only a
+ *           terminal still waiting for pit_isr to start its shell counts
+ */
+static uint32_t sched_next_deadline(void){
+    uint32_t i;
+
+    for(i = 0; i < TERM_NUM; i++){
+        if(!terms[i].cur_pid)
+            return 1;
+    }
+    return 0;
+}
+
+/* void pit_idle;
+ * Inputs: None
+ * Return Value: None
+ * Function: Called with interrupts off before the boot CPU's idle loop
+ *           halts, once no CPU is running a task: arms a
+ *           single interrupt for the next deadline, or stops the PIT when
+ *           there is none, so an idle system isn't woken 100 times a second.
+ *           An armed timer is left alone, or other interrupts would keep
+ *           pushing the deadline back
+ */
+static void pit_idle(void){
+#ifndef SCHED_PERIODIC_IDLE
+    uint32_t ticks, i;
+
+    /* The other CPUs get their ticks forwarded from pit_isr */
+    for(i = 1; i < smp_cpu_count; i++){
+        if(cpus[i].busy){
+            pit_busy();
+            return;
+        }
+    }
+    if(pit_state == PIT_ONESHOT)
+        return;
+    if((ticks = sched_next_deadline())){
+        ticks = ticks * PIT_DIV;
+        pit_program(PIT_MODE0, ticks < PIT_MAX_COUNT ? ticks : PIT_MAX_COUNT);
+        pit_state = PIT_ONESHOT;
+    } else if(pit_state != PIT_STOPPED){
+        outb(PIT_MODE0, PIT_CMD_REG);
+        pit_state = PIT_STOPPED;
+    }
+#endif
+}
+
+/* void tick_idle;
+ * Inputs: cpu - this CPU, about to halt
+ * Return Value: None
+ * Function: pit_idle for the local APIC timer: every CPU stops its own,
+ *           except that the boot CPU, which starts the shells, arms it for
+ *           the next deadline
+ */
+static void tick_idle(cpu_t* cpu){
+    uint32_t ticks;
+
+    if(!apic_timer_count){
+        if(!cpu->id)
+            pit_idle();
+        return;
+    }
+#ifdef SCHED_PERIODIC_IDLE
+    tick_busy(cpu);
+#else
+    if(cpu->tick_state == PIT_ONESHOT)
+        return;
+    if(!cpu->id && (ticks = sched_next_deadline())){
+        lapic_timer_start(ticks * apic_timer_count, 0);
+        cpu->tick_state = PIT_ONESHOT;
+    } else if(cpu->tick_state != PIT_STOPPED){
+        lapic_timer_stop();
+        cpu->tick_state = PIT_STOPPED;
+    }
+#endif
+}
+
+/* sched_rq_t* rq_lock_task;
+ * Inputs: task - any task
+ * Return Value: the run queue the task belongs to, locked
+ * Function: task->cpu only changes when the task is switched in, so it is
+ *           checked again once the lock is held
+ */
+static sched_rq_t* rq_lock_task(PCB_t* task){
+    sched_rq_t* rq;
+
+    while(1){
+        rq = &run_queues[task->cpu];
+        spin_lock(&rq->lock);
+        if(rq == &run_queues[task->cpu])
+            return rq;
+        spin_unlock(&rq->lock);
+    }
+}
+
+/* void rq_enqueue;
+ * Inputs: task - a task that can run but isn't running
+ *         kick - whether to wake an idle CPU for it
+ * Return Value: None
+ */
+static void rq_enqueue(PCB_t* task, uint8_t kick){
+    sched_rq_t* rq;
+    uint32_t cpu, i;
+
+    task->state = TASK_RUNNABLE;
+    rq = rq_lock_task(task);
+    if(task->on_rq){
+        spin_unlock(&rq->lock);
+        return;
+    }
+    sched_policy->enqueue(rq, task);
+    task->on_rq = 1;
+    cpu = task->cpu;
+    spin_unlock(&rq->lock);
+
+    if(!kick)
+        return;
+    /* The task's own CPU if it is idle, or else any idle CPU, which will
+     * steal it */
+    if(!cpus[cpu].busy){
+        smp_kick_idle(cpu);
+        return;
+    }
+    for(i = 0; i < smp_cpu_count; i++){
+        if(!cpus[i].busy && cpus[i].online){
+            smp_kick_idle(i);
+            return;
+        }
+    }
+}
+
+/* void sched_start_shells;
+ * Inputs: None
+ * Return Value: None
+ * Function: Starts a shell on one terminal that has none, a different
+ * terminal each tick
+ */
+static void sched_start_shells(void){
+    static uint8_t cur_proc_ind = 0;
+
+    cur_proc_ind = (cur_proc_ind + 1) % TERM_NUM;
+    if (!terms[cur_proc_ind].cur_pid) {
+        /* execute wasn't written for two CPUs at once */
+        kernel_lock();
+        if (!terms[cur_proc_ind].cur_pid)
+            _syscall_execute("shell", cur_proc_ind);
+        kernel_unlock();
+    }
+}
+
 /* void pit_isr;
  * Inputs: None
  * Return Value: None
- * Function: Interrupt handler for PIT, schedules processes to run
- * in a round robin fashion
+ * Function: Interrupt handler for PIT, starts a shell on terminals that
+ * have none, passes the tick on to the other CPUs and then takes it on
+ * this one. common_isr has already sent the EOI
  */
 void pit_isr(){
-    static uint8_t cur_proc_ind = 0;
-    /* Send an eoi first as always */
-    send_eoi(PIT_IRQNUM);
+    if(pit_state == PIT_ONESHOT)
+        pit_state = PIT_STOPPED;
+
+    kdata_update_clock();
+    sched_start_shells();
+    smp_tick_others();
+    sched_tick();
+}
 
-    uint8_t next_pid;
+/* void sched_timer_isr;
+ * Inputs: None
+ * Return Value: None
+ * Function: Interrupt handler for each CPU's local APIC timer, which
+ * replaces the PIT when there is one; the boot CPU's also starts shells
+ */
+void sched_timer_isr(void){
+    cpu_t* cpu = this_cpu();
+
+    if(cpu->tick_state == PIT_ONESHOT)
+        cpu->tick_state = PIT_STOPPED;
+    kdata_update_clock();
+    if(!cpu->id)
+        sched_start_shells();
+    sched_tick();
+}
+
+/* void sched_tick;
+ * Inputs: None
+ * Return Value: None
+ * Function: Charges a tick to the task running on this CPU and preempts
+ * it once its time slice is used up
+ */
+void sched_tick(void){
     PCB_t* cur_proc = get_cur_pcb();
+    PCB_t* next_proc;
 
-    // Sanity check
-    if(!cur_proc)
+    if(cur_proc == SCHED_IDLE_PCB)
+        return;
+    cur_proc->run_ticks++;
+    if(sched_policy->tick)
+        sched_policy->tick(cur_proc);
+    if(cur_proc->slice_left && --cur_proc->slice_left)
         return;
+    if(sched_policy->expire)
+        sched_policy->expire(cur_proc);
+    /* No kick: an idle CPU would take the task every time its slice ran out */
+    rq_enqueue(cur_proc, 0);
 
-    cur_proc_ind = (cur_proc_ind + 1) % TERM_NUM;
-    if (!terms[cur_proc_ind].cur_pid) {
-        _syscall_execute("shell", cur_proc_ind);
+    next_proc = sched_pick_next();
+    /* Keep running if nothing else can */
+    if(next_proc == cur_proc){
+        next_proc->slice_left = sched_policy->time_slice(next_proc);
+        return;
     }
-    else{
-        next_pid = terms[cur_proc_ind].cur_pid;
+    /* NULL if an idle CPU took the task in the meantime */
+    sched_switch(cur_proc, next_proc ? next_proc : SCHED_IDLE_PCB);
+}
+
+/* void sched_enqueue;
+ * Inputs: task - a task that can run but isn't running
+ * Return Value: None
+ * Function: Marks the task runnable and hands it to the policy, on the
+ *           queue of the CPU it last ran on
+ */
+void sched_enqueue(PCB_t* task){
+    rq_enqueue(task, 1);
+}
+
+/* void sched_dequeue;
+ * Inputs: task - any task
+ * Return Value: None
+ * Function: Takes the task off its run queue if it is on it
+ */
+void sched_dequeue(PCB_t* task){
+    sched_rq_t* rq = rq_lock_task(task);
+
+    if(task->on_rq){
+        sched_policy->dequeue(rq, task);
+        task->on_rq = 0;
     }
+    spin_unlock(&rq->lock);
+}
 
-    /* Return if there is no other process to schedule */
-    if(cur_proc->pid == next_pid){
-        return;
+/* PCB_t* sched_pick_next;
+ * Inputs: None
+ * Return Value: the task the policy wants to run next, taken off this
+ * CPU's run queue, or NULL if the queue is empty
+ */
+PCB_t* sched_pick_next(void){
+    sched_rq_t* rq = this_rq();
+    PCB_t* task;
+
+    spin_lock(&rq->lock);
+    if((task = sched_policy->pick_next(rq)))
+        task->on_rq = 0;
+    spin_unlock(&rq->lock);
+    return task;
+}
+
+/* PCB_t* sched_steal;
+ * Inputs: None
+ * Return Value: a task taken off another CPU's run queue, or NULL if they
+ * are all empty
+ * Function: Called by an idle CPU whose own queue is empty. The other
+ *           queue's policy picks, so it gives up the task it would have
+ *           run next; sched_switch moves the task over
+ */
+static PCB_t* sched_steal(void){
+    uint32_t self = this_cpu()->id, i;
+    sched_rq_t* rq;
+    PCB_t* task;
+
+    for(i = 0; i < smp_cpu_count; i++){
+        rq = &run_queues[i];
+        if(i == self || !rq->head)
+            continue;
+        spin_lock(&rq->lock);
+        if((task = sched_policy->pick_next(rq)))
+            task->on_rq = 0;
+        spin_unlock(&rq->lock);
+        if(task){
+            run_queues[self].steals++;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/* int32_t sched_set_policy;
+ * Inputs: policy - SCHED_RR, SCHED_FAIR or SCHED_MLFQ
+ * Return Value: the previous policy, or -1 if policy is not valid
+ * Function: Moves every queued task, on every CPU, over to the new policy
+ */
+int32_t sched_set_policy(int32_t policy){
+    int32_t old = sched_policy_ind;
+    PCB_t* queued[MAX_PROC_NUM];
+    uint32_t n = 0, i;
+
+    if(policy < 0 || policy >= SCHED_POLICY_NUM)
+        return -1;
+    for(i = 0; i < SMP_MAX_CPUS; i++)
+        spin_lock(&run_queues[i].lock);
+    for(i = 0; i < SMP_MAX_CPUS; i++){
+        while((queued[n] = sched_policy->pick_next(&run_queues[i])))
+            n++;
     }
+    sched_policy_ind = policy;
+    sched_policy = &sched_policies[policy];
+    /* Back on the queues they came off, which are still locked */
+    for(i = 0; i < n; i++)
+        sched_policy->enqueue(&run_queues[queued[i]->cpu], queued[i]);
+    for(i = 0; i < SMP_MAX_CPUS; i++)
+        spin_unlock(&run_queues[i].lock);
+    return old;
+}
 
-    PCB_t* next_proc = (PCB_t *) TASK_KSTACK_TOP(next_pid);
-
-    /* Setup next process's paging */
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(next_pid);
-    if(next_proc->term_ind != cur_term_ind){
-        user_vidmem_page_table[0].page_addr = BACKGROUND_1 + next_proc->term_ind;
-    }
-    else{
-        user_vidmem_page_table[0].page_addr = VID_MEM_ADDR;
-    }
-    tss.esp0 = TASK_KSTACK_BOT(next_pid);
-    tss.ss0 = KERNEL_DS;
-    /* Flush TLB */
-    asm volatile(
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-    );
-
-    /* save current esp and ebp */
-    asm volatile(
-        " movl %%esp, %0; "
-        " movl %%ebp, %1; "
-        : "=m" (cur_proc->esp), "=m" (cur_proc->ebp)
-    );
-
-    /* Restore next process's esp and ebp */
-    asm volatile(
-        " movl %0, %%esp; "
-        " movl %1, %%ebp; "
-        :
-        : "m" (next_proc->esp), "m" (next_proc->ebp)
-    );
+/* int32_t sched_set_nice;
+ * Inputs: task - any task
+ *         nice - its new base priority, 0 to SCHED_NICE_MAX
+ * Return Value: the previous value, or -1 if nice is not valid
+ * Function: Only the MLFQ policy looks at it: the task never rises above
+ *           level nice
+ */
+int32_t sched_set_nice(PCB_t* task, int32_t nice){
+    int32_t old = task->nice;
+    uint32_t flags;
+
+    if(nice < 0 || nice > SCHED_NICE_MAX)
+        return -1;
+    cli_and_save(flags);
+    task->nice = nice;
+    if(task->sched_level < nice)
+        task->sched_level = nice;
+    restore_flags(flags);
+    return old;
+}
+
+/* void sched_boost;
+ * Inputs: task - the running task, about to wait for keyboard input
+ * Return Value: None
+ */
+void sched_boost(PCB_t* task){
+    if(sched_policy->boost)
+        sched_policy->boost(task);
+}
+
+/* void sched_sleep;
+ * Inputs: wq - what the running task waits for
+ *         lock - the lock that protects wq and the condition
+ * Return Value: None; returns, with lock held again, once the task has
+ *               been woken and scheduled
+ * Function: Takes the running task off the CPU until sched_wake_all is
+ *           called on wq. lock must be held from checking the condition
+ *           until here, so a wakeup can't slip in between; callers check
+ *           the condition again when this returns
+ */
+void sched_sleep(wait_queue_t* wq, spinlock_t* lock){
+    PCB_t* cur_proc = get_cur_pcb();
+    PCB_t* next_proc;
+
+    cur_proc->state = TASK_BLOCKED;
+    cur_proc->wq_next = NULL;
+    if(wq->tail)
+        wq->tail->wq_next = cur_proc;
+    else
+        wq->head = cur_proc;
+    wq->tail = cur_proc;
+    spin_unlock(lock);
+
+    next_proc = sched_pick_next();
+    /* Already woken by another CPU and nothing else to run */
+    if(next_proc != cur_proc)
+        sched_switch(cur_proc, next_proc ? next_proc : SCHED_IDLE_PCB);
+    spin_lock(lock);
+}
+
+/* void sched_wake_all;
+ * Inputs: wq - a wait queue
+ * Return Value: None
+ * Function: Puts every task asleep on wq back on the run queue; the
+ *           caller holds the lock passed to sched_sleep. Safe to call from
+ *           interrupt handlers
+ */
+void sched_wake_all(wait_queue_t* wq){
+    PCB_t* task;
+    PCB_t* next;
+
+    task = wq->head;
+    wq->head = wq->tail = NULL;
+    while(task){
+        next = task->wq_next;
+        sched_enqueue(task);
+        task = next;
+    }
+}
+
+/* void sched_idle_loop;
+ * Inputs: None
+ * Return Value: None; never returns
+ * Function: What each CPU does once it is up: runs whatever is on its
+ *           run queue, or on another CPU's, and halts when nothing is
+ */
+void sched_idle_loop(void){
+    PCB_t* next_proc;
+
+    while(1){
+        cli();
+        if((next_proc = sched_pick_next()) || (next_proc = sched_steal())){
+            sched_switch(SCHED_IDLE_PCB, next_proc);
+        } else {
+            tick_idle(this_cpu());
+            /* sti takes effect after hlt starts, so no wakeup is missed */
+            asm volatile ("sti; hlt");
+        }
+    }
+}
+
+/* void sched_account;
+ * Inputs: rq - this CPU's run queue
+ *         cur_proc - the task giving up the CPU, the idle loop, or NULL
+ *         now - the TSC
+ * Return Value: None
+ */
+static void sched_account(sched_rq_t* rq, PCB_t* cur_proc, uint64_t now){
+    if(cur_proc == SCHED_IDLE_PCB)
+        rq->idle_cycles += now - rq->run_start_tsc;
+    else if(cur_proc)
+        cur_proc->cpu_cycles += now - rq->run_start_tsc;
+    rq->run_start_tsc = now;
+}
+
+/* int32_t sched_get_task_stats;
+ * Inputs: stats - array to fill
+ *         max - its length
+ * Return Value: number of entries filled in
+ * Function: Reports the idle loops, added up over the CPUs, and then
+ *           every task, with the CPU time they have used up to now
+ */
+int32_t sched_get_task_stats(task_stat_t* stats, uint32_t max){
+    uint32_t n = 0, pid;
+    uint64_t idle_cycles = 0;
+    PCB_t* task;
+
+    sched_account(this_rq(), get_cur_pcb(), rdtsc());
+    for(pid = 0; pid < SMP_MAX_CPUS; pid++)
+        idle_cycles += run_queues[pid].idle_cycles;
+    if(max){
+        stats[0].pid = 0;
+        stats[0].term_ind = 0;
+        stats[0].state = TASK_RUNNABLE;
+        stats[0].run_ticks = 0;
+        stats[0].cpu_cycles = idle_cycles;
+        n = 1;
+    }
+    for(pid = 1; pid < MAX_PROC_NUM && n < max; pid++){
+        if(!(task = task_pcbs[pid]))
+            continue;
+        stats[n].pid = pid;
+        stats[n].term_ind = task->term_ind;
+        stats[n].state = task->state;
+        stats[n].run_ticks = task->run_ticks;
+        stats[n].cpu_cycles = task->cpu_cycles;
+        n++;
+    }
+    return n;
+}
+
+/* void sched_switch;
+ * Inputs: cur_proc - the running process, or NULL if it is exiting and
+ *                    will never be resumed
+ *         next_proc - the process to run, or SCHED_IDLE_PCB
+ * Return Value: None; returns when cur_proc is switched back to, on
+ *               whichever CPU that happens
+ * Function: Switches address space, kernel stack and registers to next_proc
+ */
+void sched_switch(PCB_t* cur_proc, PCB_t* next_proc){
+    cpu_t* cpu = this_cpu();
+    sched_rq_t* rq = &run_queues[cpu->id];
+    switch_stats_t* stats;
+    uint64_t now;
+    uint32_t depth;
+
+    /* The CPU next_proc last ran on may still be on its way out of it,
+     * and uses next_proc->cpu to know which CPU it is until it is out */
+    while(next_proc->on_cpu)
+        asm volatile ("pause");
+
+    now = rdtsc();
+    rq->switch_start_tsc = (uint32_t) now;
+    sched_account(rq, cur_proc, now);
+    if(next_proc == cpu->idle){
+        cpu->busy = 0;
+        /* The idle loop has no user space; leave the exiting task's
+         * directory, which is about to be freed */
+        page_switch_task(page_directory);
+    } else {
+        tick_busy(cpu);
+        cpu->busy = 1;
+        next_proc->cpu = cpu->id;
+        next_proc->slice_left = sched_policy->time_slice(next_proc);
+        /* Setup next process's paging */
+        page_set_user_vidmem(next_proc->page_dir, cpu->id, next_proc->term_ind,
+                next_proc->term_ind == cur_term_ind);
+        kdata_set_task(cpu->id, next_proc);
+        cpu->tss.esp0 = TASK_KSTACK_BOT(next_proc);
+        /* Only the user entries leave the TLB; kernel pages are global */
+        page_switch_task(next_proc->page_dir);
+    }
+    fpu_switch(cur_proc, next_proc);
+
+    next_proc->on_cpu = 1;
+    rq->prev = cur_proc;
+    depth = kernel_lock_release();
+    context_switch(cur_proc ? &cur_proc->ksp : NULL, next_proc->ksp);
+    sched_finish_switch();
+    kernel_lock_reacquire(depth);
+
+    /* Back in cur_proc; account for the switch that brought us here */
+    rq = this_rq();
+    stats = &rq->switch_stats;
+    stats->last_cycles = rdtsc_lo() - rq->switch_start_tsc;
+    if (!stats->switches || stats->last_cycles < stats->min_cycles) {
+        stats->min_cycles = stats->last_cycles;
+    }
+    if (stats->last_cycles > stats->max_cycles) {
+        stats->max_cycles = stats->last_cycles;
+    }
+    stats->switches++;
+}
+
+/* void sched_finish_switch;
+ * Inputs: None
+ * Return Value: None
+ * Function: Run by the task just switched to, on its own stack: lets other
+ *           CPUs have the task switched away from, now that nothing here
+ *           uses its stack, and frees it if it exited
+ */
+void sched_finish_switch(void){
+    sched_rq_t* rq = this_rq();
+    PCB_t* dead;
+
+    if(rq->prev){
+        asm volatile ("" : : : "memory");
+        rq->prev->on_cpu = 0;
+        rq->prev = NULL;
+    }
+    if((dead = rq->dead)){
+        rq->dead = NULL;
+        task_release(dead);
+    }
+}
+
+/* void sched_exit;
+ * Inputs: task - the running task, which has exited
+ *         next_proc - the process to run, or SCHED_IDLE_PCB
+ * Return Value: None; never returns
+ * Function: The task's kernel stack is in use until the switch is done,
+ *           so whatever runs next frees it
+ */
+void sched_exit(PCB_t* task, PCB_t* next_proc){
+    this_rq()->dead = task;
+    sched_switch(NULL, next_proc);
+}
+
+/* void sched_get_stats;
+ * Inputs: stats - where to copy the counters
+ * Return Value: None
+ * Function: Copies out the context switch counters, added up over the
+ *           CPUs; last_cycles is this CPU's
+ */
+void sched_get_stats(switch_stats_t *stats){
+    switch_stats_t* cpu_stats;
+    uint32_t i;
+
+    stats->switches = 0;
+    stats->last_cycles = this_rq()->switch_stats.last_cycles;
+    stats->min_cycles = stats->max_cycles = 0;
+    for(i = 0; i < SMP_MAX_CPUS; i++){
+        cpu_stats = &run_queues[i].switch_stats;
+        if(!cpu_stats->switches)
+            continue;
+        if(!stats->switches || cpu_stats->min_cycles < stats->min_cycles)
+            stats->min_cycles = cpu_stats->min_cycles;
+        if(cpu_stats->max_cycles > stats->max_cycles)
+            stats->max_cycles = cpu_stats->max_cycles;
+        stats->switches += cpu_stats->switches;
+    }
+}
+
+/* void sched_get_cpu_stats;
+ * Inputs: stats - where to copy the counters
+ * Return Value: None
+ * Function: Reports how many CPUs are up and, for each, its idle time and
+ *           how many tasks it has stolen
+ */
+void sched_get_cpu_stats(cpu_stats_t *stats){
+    uint32_t i;
+
+    sched_account(this_rq(), get_cur_pcb(), rdtsc());
+    stats->cpus = smp_cpu_count;
+    for(i = 0; i < SMP_MAX_CPUS; i++){
+        stats->steals[i] = run_queues[i].steals;
+        stats->idle_cycles[i] = run_queues[i].idle_cycles;
+    }
 }
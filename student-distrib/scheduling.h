@@ -11,18 +11,130 @@
 #include "lib.h"
 #include "syscall.h"
 #include "page.h"
+#include "smp.h"
+#include "spinlock.h"
 
 #define CLOCK_TICK_RATE   1193182
-#define _33HZ_DIV            36157
+// Scheduler tick; time slices are counted in these
+#define PIT_HZ                 100
+#define PIT_DIV           (CLOCK_TICK_RATE / PIT_HZ)
 
 #define PIT_DATA0_PORT     0x40
 #define PIT_CMD_REG        0x43
 
 #define PIT_MODE3          0x36
+// One-shot: a single interrupt when the count runs out. Writing just the
+// command stops the counter until a count is loaded
+#define PIT_MODE0          0x30
+#define PIT_MAX_COUNT      0xFFFF
+
+// What the PIT, or a CPU's local APIC timer, is set up to do
+#define PIT_PERIODIC       0
+#define PIT_ONESHOT        1    // armed, not fired yet
+#define PIT_STOPPED        2
 
 #define PIT_IRQNUM         0
 
+// Scheduling policies, chosen with sched_set_policy
+#define SCHED_RR           0
+#define SCHED_FAIR         1
+#define SCHED_MLFQ         2
+#define SCHED_POLICY_NUM   3
+
+// Time slices in PIT ticks
+#define SCHED_RR_SLICE     3
+#define SCHED_FAIR_SLICE   1
+// MLFQ level k gets a slice of 1 << k ticks
+#define SCHED_MLFQ_LEVELS  4
+// PIT ticks between raising every task back to its base level, so tasks
+// stuck at the bottom can't starve
+#define SCHED_MLFQ_BOOST   PIT_HZ
+// nice values run from 0 (default) to the lowest level
+#define SCHED_NICE_MAX     (SCHED_MLFQ_LEVELS - 1)
+
+// This CPU's idle context (the boot context on the boot CPU); it idles
+// when there is nothing on the run queues
+#define SCHED_IDLE_PCB     (this_cpu()->idle)
+
+// TSC cycles spent switching from one task to the next
+typedef struct {
+    uint32_t switches;
+    uint32_t last_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+} switch_stats_t;
+
+/* Each CPU's run queue, with the runnable tasks that aren't running,
+ * oldest first, and the CPU's own scheduling state. Every policy keeps its
+ * tasks here and they differ only in which one they take off */
+typedef struct sched_rq {
+    spinlock_t lock;
+    PCB_t *head;
+    PCB_t *tail;
+    // Virtual run time of the task the fair policy picked last
+    uint32_t fair_min_key;
+    // When the running task (or the idle loop) got the CPU
+    uint64_t run_start_tsc;
+    uint64_t idle_cycles;
+    uint32_t switch_start_tsc;
+    switch_stats_t switch_stats;
+    // Tasks this CPU took off other CPUs' queues
+    uint32_t steals;
+    // Left for sched_finish_switch by the switch away from them
+    PCB_t *prev;
+    PCB_t *dead;
+} sched_rq_t;
+
+/* A scheduling policy owns the run queues: it is handed every runnable
+ * task that isn't running and decides which one runs next and for how
+ * long. The queue ops are called with the queue locked */
+typedef struct sched_policy {
+    const int8_t *name;
+    void (*enqueue)(sched_rq_t *rq, PCB_t *task);
+    void (*dequeue)(sched_rq_t *rq, PCB_t *task);
+    // Takes the next task to run off the queue; NULL if it is empty
+    PCB_t *(*pick_next)(sched_rq_t *rq);
+    // Called on every PIT tick the task runs for; may be NULL
+    void (*tick)(PCB_t *task);
+    // Called when the task has used up its whole slice; may be NULL
+    void (*expire)(PCB_t *task);
+    // Called when the task goes to sleep waiting for the user; may be NULL
+    void (*boost)(PCB_t *task);
+    uint32_t (*time_slice)(PCB_t *task);
+} sched_policy_t;
+
+// CPU time of one task, as reported by kstat; pid 0 is the idle loop
+typedef struct {
+    uint32_t pid;
+    uint32_t term_ind;
+    uint32_t state;
+    uint32_t run_ticks;
+    uint64_t cpu_cycles;
+} task_stat_t;
+
 void init_pit(void);
 void pit_isr(void);
+void sched_timer_isr(void);
+void sched_tick(void);
+void sched_enqueue(PCB_t* task);
+void sched_dequeue(PCB_t* task);
+PCB_t* sched_pick_next(void);
+void sched_switch(PCB_t* cur_proc, PCB_t* next_proc);
+void sched_exit(PCB_t* task, PCB_t* next_proc);
+void sched_finish_switch(void);
+int32_t sched_set_policy(int32_t policy);
+int32_t sched_set_nice(PCB_t* task, int32_t nice);
+void sched_boost(PCB_t* task);
+void sched_sleep(wait_queue_t* wq, spinlock_t* lock);
+void sched_wake_all(wait_queue_t* wq);
+void sched_idle_loop(void);
+int32_t sched_get_task_stats(task_stat_t* stats, uint32_t max);
+void sched_get_stats(switch_stats_t *stats);
+void sched_get_cpu_stats(cpu_stats_t *stats);
+
+/* Low level switch between kernel stacks, in idt_asm.S */
+extern void context_switch(uint8_t **save_esp, uint8_t *new_esp);
+/* Where a new task's kernel stack starts out returning to */
+extern void task_entry(void);
 
 #endif
@@ -2,6 +2,7 @@
 #include "syscall.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "smp.h"
 
 void check_signals(hw_context_t *context) {
     PCB_t *task_pcb = get_cur_pcb();
@@ -35,7 +36,11 @@ void check_signals(hw_context_t *context) {
             }
 
             if (i < 3) {
+                // Signals are checked on the way out, after the kernel
+                // lock was dropped
+                kernel_lock();
                 _syscall_halt(256, context);
+                kernel_unlock();
             }
             // Ignore others
         }
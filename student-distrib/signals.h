@@ -13,6 +13,15 @@ typedef enum {
     SIG_SIZE,
 } signal_t;
 
+// Order of the registers common_isr saves in hw_context_t.regs
+#define HW_CONTEXT_EBX  0
+#define HW_CONTEXT_EAX  6
+#define HW_CONTEXT_DS   7
+#define HW_CONTEXT_ES   8
+#define HW_CONTEXT_FS   9
+// Interrupt enable flag in eflags
+#define EFLAGS_IF       0x200
+
 typedef struct {
     uint32_t regs[10];
     uint32_t irq_num;
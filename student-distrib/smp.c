@@ -0,0 +1,256 @@
+#include "smp.h"
+#include "apic.h"
+#include "lib.h"
+#include "page.h"
+#include "idt.h"
+#include "fpu.h"
+#include "spinlock.h"
+#include "scheduling.h"
+
+// Waits from the MP startup algorithm
+#define SMP_INIT_DELAY_US   10000
+#define SMP_SIPI_DELAY_US   200
+// How long the APs get to report in
+#define SMP_BOOT_WAIT_MS    100
+
+cpu_t cpus[SMP_MAX_CPUS];
+uint32_t smp_cpu_count = 1;
+/* Used by ap_start32: the index the next AP takes, how many get one, and
+ * the top of each one's idle stack */
+uint32_t ap_next_cpu = 1;
+uint32_t ap_cpu_limit = 1;
+uint32_t ap_stack_tops[SMP_MAX_CPUS];
+
+static spinlock_t kernel_spinlock = SPINLOCK_INIT;
+/* CPU holding the kernel lock, or -1, and how many times it took it */
+static volatile int32_t kernel_owner = -1;
+static uint32_t kernel_depth;
+
+void ap_main(uint32_t id);
+
+/* Function: smp_cpu_setup
+ * Inputs: cpu - the CPU running this
+ * Return Value: none
+ * Description: Loads the CPU's own copy of the GDT, whose TSS descriptor
+ *              points at the CPU's own TSS; a TSS can't be loaded by two
+ *              CPUs, and each needs its own esp0 anyway
+ */
+static void smp_cpu_setup(cpu_t *cpu) {
+    seg_desc_t tss_desc = tss_desc_ptr;
+
+    memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+    cpu->tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->tss.ss0 = KERNEL_DS;
+    cpu->tss.esp0 = TASK_KSTACK_BOT(cpu->idle);
+    SET_TSS_PARAMS(tss_desc, &cpu->tss, tss_size);
+    // Available, not busy
+    tss_desc.type = 0x9;
+    cpu->gdt[KERNEL_TSS >> 3] = tss_desc;
+
+    cpu->gdt_desc.size = sizeof(cpu->gdt) - 1;
+    cpu->gdt_desc.addr = (uint32_t) cpu->gdt;
+    asm volatile ("lgdt (%0)" : : "r" (&cpu->gdt_desc.size) : "memory");
+    ltr(KERNEL_TSS);
+    lldt(KERNEL_LDT);
+    sysenter_init_cpu(&cpu->tss.esp0);
+}
+
+/* Function: ap_main
+ * Inputs: id - the index ap_start32 gave this CPU
+ * Return Value: none; never returns
+ * Description: Where an application processor lands once it is in
+ *              protected mode with paging on, on its idle stack
+ */
+void ap_main(uint32_t id) {
+    cpu_t *cpu = &cpus[id];
+
+    smp_cpu_setup(cpu);
+    lapic_init_cpu(cpu);
+    fpu_init_cpu();
+    cpu->online = 1;
+    sched_idle_loop();
+}
+
+/* Function: smp_init
+ * Inputs: none
+ * Return Value: none
+ * Description: Sets up the boot CPU's per-CPU state and, if there is a
+ *              local APIC, starts the other CPUs with INIT and two
+ *              STARTUP IPIs. There is no MP table parsing: the IPIs go to
+ *              every other CPU and the ones past SMP_MAX_CPUS park
+ *              themselves. Must run before the first task is created, so
+ *              every task's directory maps the APIC
+ */
+void smp_init(void) {
+    PCB_t *boot = (PCB_t *) TASK_BOOT_KSTACK_TOP;
+    uint32_t stack, i, waited;
+
+    boot->cpu = 0;
+    cpus[0].idle = boot;
+    cpus[0].online = 1;
+    smp_cpu_setup(&cpus[0]);
+
+    SET_IDT_ENTRY(idt[SPURIOUS_INT], _spurious_isr);
+    idt[SPURIOUS_INT].present = 1;
+
+    if (apic_init()) {
+        return;
+    }
+
+    SET_IDT_ENTRY(idt[IPI_TICK_INT], _ipi_tick_isr);
+    idt[IPI_TICK_INT].present = 1;
+    SET_IDT_ENTRY(idt[IPI_RESCHED_INT], _ipi_resched_isr);
+    idt[IPI_RESCHED_INT].present = 1;
+
+    // Idle stacks, with their PCBs, for the APs
+    for (i = 1; i < SMP_MAX_CPUS; i++) {
+        if (!(stack = frame_alloc_aligned(TASK_KSTACK_FRAMES))) {
+            break;
+        }
+        memset((void *) stack, 0, sizeof(PCB_t));
+        cpus[i].id = i;
+        cpus[i].idle = (PCB_t *) stack;
+        cpus[i].idle->cpu = i;
+        ap_stack_tops[i] = TASK_KSTACK_BOT(stack);
+    }
+    ap_cpu_limit = i;
+
+    // The APs run the trampoline with paging off, so it only needs to be
+    // mapped while it is copied
+    page_map_low(SMP_TRAMPOLINE_ADDR, 1);
+    memcpy((void *) SMP_TRAMPOLINE_ADDR, smp_trampoline, smp_trampoline_end - smp_trampoline);
+    page_map_low(SMP_TRAMPOLINE_ADDR, 0);
+
+    lapic_send(0, LAPIC_ICR_OTHERS | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT | LAPIC_ICR_INIT);
+    apic_delay_us(SMP_INIT_DELAY_US);
+    for (i = 0; i < 2; i++) {
+        lapic_send(0, LAPIC_ICR_OTHERS | LAPIC_ICR_ASSERT | LAPIC_ICR_STARTUP
+                | (SMP_TRAMPOLINE_ADDR >> ADDRESS_SHIFT));
+        apic_delay_us(SMP_SIPI_DELAY_US);
+    }
+
+    for (waited = 0; waited < SMP_BOOT_WAIT_MS; waited++) {
+        for (i = 1; i < ap_cpu_limit && cpus[i].online; i++);
+        if (i == ap_cpu_limit) {
+            break;
+        }
+        apic_delay_us(1000);
+    }
+    for (i = 1; i < ap_cpu_limit && cpus[i].online; i++);
+    smp_cpu_count = i;
+}
+
+/* Function: smp_send_ipi
+ * Inputs: cpu - index of the target CPU
+ *         vector - IDT vector to raise there
+ * Return Value: none
+ */
+void smp_send_ipi(uint32_t cpu, uint32_t vector) {
+    lapic_send(cpus[cpu].apic_id, LAPIC_ICR_ASSERT | vector);
+}
+
+/* Function: smp_tick_others
+ * Inputs: none
+ * Return Value: none
+ * Description: Passes the PIT tick on to every other CPU that is running
+ *              a task, so it can be charged and preempted
+ */
+void smp_tick_others(void) {
+    uint32_t i, self = this_cpu()->id;
+
+    for (i = 0; i < smp_cpu_count; i++) {
+        if (i != self && cpus[i].busy) {
+            smp_send_ipi(i, IPI_TICK_INT);
+        }
+    }
+}
+
+/* Function: smp_kick_idle
+ * Inputs: cpu - index of a CPU
+ * Return Value: none
+ * Description: Wakes the CPU out of its idle loop's hlt, so it looks at the
+ *              run queues again; does nothing if it is running a task
+ */
+void smp_kick_idle(uint32_t cpu) {
+    if (lapic && cpu < smp_cpu_count && !cpus[cpu].busy && cpu != this_cpu()->id) {
+        smp_send_ipi(cpu, IPI_RESCHED_INT);
+    }
+}
+
+/* Function: smp_tick_isr
+ * Inputs: none
+ * Return Value: none
+ * Description: The PIT tick, forwarded by the boot CPU
+ */
+void smp_tick_isr(void) {
+    sched_tick();
+}
+
+/* Function: smp_resched_isr
+ * Inputs: none
+ * Return Value: none
+ * Description: Taking the interrupt is all it is for; the idle loop goes
+ *              round again once hlt returns
+ */
+void smp_resched_isr(void) {
+}
+
+/* Function: kernel_lock
+ * Inputs: none
+ * Return Value: none
+ * Description: Takes the kernel lock, or nests if this CPU holds it
+ */
+void kernel_lock(void) {
+    int32_t id = this_cpu()->id;
+
+    if (kernel_owner == id) {
+        kernel_depth++;
+        return;
+    }
+    spin_lock(&kernel_spinlock);
+    kernel_owner = id;
+    kernel_depth = 1;
+}
+
+/* Function: kernel_unlock
+ * Inputs: none
+ * Return Value: none
+ */
+void kernel_unlock(void) {
+    if (--kernel_depth) {
+        return;
+    }
+    kernel_owner = -1;
+    spin_unlock(&kernel_spinlock);
+}
+
+/* Function: kernel_lock_release
+ * Inputs: none
+ * Return Value: how deep this CPU held the lock, 0 if it didn't
+ * Description: Lets go of the lock entirely before a context switch
+ */
+uint32_t kernel_lock_release(void) {
+    uint32_t depth;
+
+    if (kernel_owner != this_cpu()->id) {
+        return 0;
+    }
+    depth = kernel_depth;
+    kernel_depth = 0;
+    kernel_owner = -1;
+    spin_unlock(&kernel_spinlock);
+    return depth;
+}
+
+/* Function: kernel_lock_reacquire
+ * Inputs: depth - what kernel_lock_release returned
+ * Return Value: none
+ */
+void kernel_lock_reacquire(uint32_t depth) {
+    if (!depth) {
+        return;
+    }
+    spin_lock(&kernel_spinlock);
+    kernel_owner = this_cpu()->id;
+    kernel_depth = depth;
+}
@@ -0,0 +1,76 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+/* Relevant citations and sources
+ * Intel SDM vol. 3A ch.10 (APIC) and 8.4 (MP initialization)
+ * https://wiki.osdev.org/Symmetric_Multiprocessing
+ */
+
+// CPUs brought up at most; any others are parked in ap_start32
+#define SMP_MAX_CPUS        4
+// Where the application processors start, in real mode. SIPI takes the
+// page number, so this has to be page aligned and below 1 MB
+#define SMP_TRAMPOLINE_ADDR 0x8000
+// Each CPU loads its own copy of the GDT, with its own TSS descriptor
+#define SMP_GDT_ENTRIES     8
+
+#ifndef ASM
+
+#include "types.h"
+#include "task.h"
+#include "x86_desc.h"
+#include "syscall.h"
+
+typedef struct cpu {
+    uint8_t id;
+    uint8_t apic_id;
+    volatile uint8_t online;
+    // Running a task rather than its idle loop
+    volatile uint8_t busy;
+    // What its local APIC timer is set up to do, one of the PIT_ states
+    uint8_t tick_state;
+    // The idle loop's stack and PCB
+    PCB_t *idle;
+    // Whose x87/SSE state is in this CPU's registers
+    PCB_t *fpu_owner;
+    tss_t tss;
+    seg_desc_t gdt[SMP_GDT_ENTRIES];
+    x86_desc_t gdt_desc;
+} cpu_t;
+
+// What kstat reports for each CPU
+typedef struct {
+    uint32_t cpus;
+    uint32_t steals[SMP_MAX_CPUS];      // tasks taken off other CPUs' queues
+    uint64_t idle_cycles[SMP_MAX_CPUS];
+} cpu_stats_t;
+
+extern cpu_t cpus[SMP_MAX_CPUS];
+extern uint32_t smp_cpu_count;
+
+// The CPU the caller is running on; every PCB, idle ones included, records
+// the CPU it was last switched in on
+#define this_cpu() (&cpus[get_cur_pcb()->cpu])
+
+void smp_init(void);
+void smp_send_ipi(uint32_t cpu, uint32_t vector);
+void smp_tick_others(void);
+void smp_kick_idle(uint32_t cpu);
+void smp_tick_isr(void);
+void smp_resched_isr(void);
+
+/* The big kernel lock: held around syscalls and exceptions, whose code
+ * was written for one CPU. It nests, and sched_switch drops it for the
+ * task being switched out and takes it back when the task resumes */
+void kernel_lock(void);
+void kernel_unlock(void);
+uint32_t kernel_lock_release(void);
+void kernel_lock_reacquire(uint32_t depth);
+
+/* AP startup code in smp_asm.S, copied to SMP_TRAMPOLINE_ADDR */
+extern uint8_t smp_trampoline[];
+extern uint8_t smp_trampoline_end[];
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
@@ -0,0 +1,56 @@
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+/* Test-and-set locks for data shared between CPUs. Kernel code already
+ * runs with interrupts off, so these only keep the other CPUs out; the
+ * _irqsave versions are for code that can also be reached with
+ * interrupts on */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock(spinlock_t *lock) {
+    uint32_t old;
+    while (1) {
+        old = 1;
+        asm volatile ("xchgl %0, %1"
+                : "+r" (old), "+m" (lock->locked)
+                :
+                : "memory");
+        if (!old) {
+            return;
+        }
+        /* Spin on a plain read so the line isn't bounced between CPUs */
+        while (lock->locked) {
+            asm volatile ("pause");
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    asm volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* Full barrier: stores before it are visible to other CPUs before any
+ * load after it is done */
+#define smp_mb() asm volatile ("lock; addl $0, (%%esp)" : : : "memory", "cc")
+
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif /* _SPINLOCK_H */
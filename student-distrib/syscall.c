@@ -4,10 +4,295 @@
 #include "task.h"
 #include "rtc.h"
 #include "file_sys.h"
+#include "page_cache.h"
 #include "x86_desc.h"
+#include "scheduling.h"
+#include "idt.h"
+#include "malloc.h"
+#include "i8259.h"
+#include "fpu.h"
+#include "io_ring.h"
+#include "pipe.h"
 
-uint8_t pid_used[MAX_PROC_NUM] = {0};
-malloc_obj_t *malloc_objs = (malloc_obj_t *) MALLOC_HEAP_MAP_START;
+PCB_t *task_pcbs[MAX_PROC_NUM] = {NULL};
+static exec_stats_t exec_stats;
+
+/* task_fill_page
+ *  Descrption: Gives a not-present user page of a task a fresh frame. Pages
+ *      of the program image get their part of the file copied in from the
+ *      page cache; everything else (and whatever lies past the end of the
+ *      file) is zeroed. The frame is written through the kernel's direct
+ *      map, so the task doesn't have to be the one that is running
+ *
+ *  Arg:
+ *      task_pcb: task owning the page
+ *      page_addr: page aligned user address
+ *
+ * 	RETURN:
+ *      0 on success, -1 if there are no free frames
+ */
+static int32_t task_fill_page(PCB_t *task_pcb, uint32_t page_addr) {
+    PTE_t *pte = &task_pcb->user_pt[PAGE_TABLE_INDEX(page_addr)];
+    uint32_t frame = frame_alloc();
+    int32_t read_size = 0;
+
+    if (!frame) {
+        return -1;
+    }
+    if (pte->available == PTE_AVAIL_LAZY) {
+        uint32_t offset = page_addr - TASK_IMG_START_ADDR;
+        if (offset < task_pcb->img_size) {
+            read_size = page_cache_read(task_pcb->img_inode, offset, (int8_t *) frame,
+                    task_pcb->img_size - offset < PAGE_SIZE ? task_pcb->img_size - offset : PAGE_SIZE);
+            if (read_size < 0) {
+                read_size = 0;
+            }
+        }
+        exec_stats.image_pages ++;
+    }
+    memset((uint8_t *) frame + read_size, 0, PAGE_SIZE - read_size);
+    // Not-present entries are never cached, so no TLB flush is needed
+    set_pte(pte, frame, 1, 1);
+    return 0;
+}
+
+/* task_copy_page
+ *  Descrption: Breaks the sharing of a copy-on-write page after a write
+ *      fault. The last task holding the frame just gets it back writable;
+ *      otherwise the page is copied into a frame of its own
+ *
+ *  Arg:
+ *      pte: the running task's entry for the page
+ *      page_addr: page aligned user address
+ *
+ * 	RETURN:
+ *      0 on success, -1 if there are no free frames
+ */
+static int32_t task_copy_page(PTE_t *pte, uint32_t page_addr) {
+    uint32_t old_frame = pte->page_addr << ADDRESS_SHIFT;
+    uint32_t frame;
+
+    if (frame_refcount(old_frame) > 1) {
+        if (!(frame = frame_alloc())) {
+            return -1;
+        }
+        memcpy((void *) frame, (void *) old_frame, PAGE_SIZE);
+        frame_free(old_frame);
+        set_pte(pte, frame, 1, 1);
+    } else {
+        pte->available = 0;
+        pte->read_write = 1;
+    }
+    flush_tlb_page(page_addr);
+    return 0;
+}
+
+/* task_fault_in
+ *  Descrption: Called by the page fault handler for faults on user pages;
+ *      backs a not-present page with a frame, filling it from the program
+ *      image if it is part of it, and copies copy-on-write pages on write
+ *
+ *  Arg:
+ *      addr: faulting linear address (CR2)
+ *      errorcode: page fault error code
+ *
+ * 	RETURN:
+ *      0 if the page was filled in and the access can be retried
+ *      -1 if the fault is a real error or memory ran out
+ */
+int32_t task_fault_in(uint32_t addr, uint32_t errorcode) {
+    PCB_t *task_pcb = get_cur_pcb();
+    PTE_t *pte;
+
+    if (addr < TASK_VIRT_PAGE_BEG || addr >= TASK_VIRT_PAGE_END) {
+        return -1;
+    }
+    pte = &task_pcb->user_pt[PAGE_TABLE_INDEX(addr)];
+    if (!pte->present) {
+        return task_fill_page(task_pcb, addr & ~(PAGE_SIZE - 1));
+    }
+    if ((errorcode & PF_ERR_WRITE) && pte->available == PTE_AVAIL_COW) {
+        return task_copy_page(pte, addr & ~(PAGE_SIZE - 1));
+    }
+    return -1;
+}
+
+/* task_image_end
+ *  Descrption: Finds where the heap can start: the end of the file or of
+ *      the highest loadable segment (which may have bss past the file),
+ *      whichever is further, rounded up to a page
+ *
+ *  Arg:
+ *      hdr: the start of the file
+ *      hdr_len: number of bytes of it in hdr
+ *      img_size: the file size
+ *
+ * 	RETURN:
+ *      the first address sbrk can hand out
+ */
+static uint32_t task_image_end(const int8_t *hdr, int32_t hdr_len, uint32_t img_size) {
+    uint32_t end = TASK_IMG_START_ADDR + img_size;
+    uint32_t ph_off = *((uint32_t *) (hdr + ELF_PHOFF_OFFSET));
+    uint32_t ph_size = *((uint16_t *) (hdr + ELF_PHENTSIZE_OFFSET));
+    uint32_t ph_num = *((uint16_t *) (hdr + ELF_PHNUM_OFFSET));
+    uint32_t i;
+
+    if (hdr_len >= ELF_PHNUM_OFFSET + 2) {
+        // Only the program headers that made it into hdr are looked at
+        for (i = 0; i < ph_num && ph_off + (i + 1) * ph_size <= hdr_len; i ++) {
+            const int8_t *ph = hdr + ph_off + i * ph_size;
+            uint32_t seg_end = *((uint32_t *) (ph + ELF_PH_VADDR_OFFSET))
+                + *((uint32_t *) (ph + ELF_PH_MEMSZ_OFFSET));
+            if (*((uint32_t *) (ph + ELF_PH_TYPE_OFFSET)) == ELF_PT_LOAD
+                    && seg_end > end && seg_end <= TASK_BRK_LIMIT) {
+                end = seg_end;
+            }
+        }
+    }
+    end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    return end < TASK_BRK_LIMIT ? end : TASK_BRK_LIMIT;
+}
+
+/* task_alloc
+ *  Descrption: Gets a kernel stack (which holds the PCB), a page directory
+ *      and empty user and mmap page tables for a new task
+ *
+ * 	RETURN:
+ *      the new task's PCB, or NULL if memory ran out
+ */
+static PCB_t *task_alloc(void) {
+    PCB_t *task_pcb = (PCB_t *) frame_alloc_aligned(TASK_KSTACK_FRAMES);
+    PDE_t *page_dir = (PDE_t *) frame_alloc();
+    PTE_t *user_pt = (PTE_t *) frame_alloc();
+    PTE_t *mmap_pt = (PTE_t *) frame_alloc();
+    if (!task_pcb || !page_dir || !user_pt || !mmap_pt) {
+        if (task_pcb) {
+            frame_free_range((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
+        }
+        if (page_dir) {
+            frame_free((uint32_t) page_dir);
+        }
+        if (user_pt) {
+            frame_free((uint32_t) user_pt);
+        }
+        if (mmap_pt) {
+            frame_free((uint32_t) mmap_pt);
+        }
+        return NULL;
+    }
+    memset(user_pt, 0, PAGE_SIZE);
+    memset(mmap_pt, 0, PAGE_SIZE);
+    page_setup_dir(page_dir, user_pt, mmap_pt);
+    task_pcb->page_dir = page_dir;
+    task_pcb->user_pt = user_pt;
+    task_pcb->mmap_pt = mmap_pt;
+    return task_pcb;
+}
+
+/* task_init_kstack
+ *  Descrption: Lays out a new task's kernel stack so that the first
+ *      context_switch to it lands in task_entry, which returns to user
+ *      space with the given context
+ *
+ *  Arg:
+ *      task_pcb: the new task
+ *      context: user registers to start with
+ */
+static void task_init_kstack(PCB_t *task_pcb, const hw_context_t *context) {
+    uint32_t *ksp = (uint32_t *) (TASK_KSTACK_BOT(task_pcb) - sizeof(hw_context_t));
+
+    *((hw_context_t *) ksp) = *context;
+    *--ksp = (uint32_t) task_entry;     // context_switch's return address
+    *--ksp = 0;                         // ebp
+    *--ksp = 0;                         // ebx
+    *--ksp = 0;                         // esi
+    *--ksp = 0;                         // edi
+    task_pcb->ksp = (uint8_t *) ksp;
+}
+
+/* file_set_nonblock
+ *  Descrption: Turns a descriptor's non-blocking mode on or off. While it
+ *      is on, the task may read at any time, so it counts as waiting for
+ *      the file (see poll_wait); a terminal keeps its keys for it
+ *  Arg:
+ *      file: an open descriptor of the running task
+ *      on: 1 or 0
+ */
+static void file_set_nonblock(FILE *file, uint8_t on) {
+    if (file->flags.nonblock == on) {
+        return;
+    }
+    file->flags.nonblock = on;
+    if (file->file_ops->poll_wait) {
+        file->file_ops->poll_wait(file, on ? 1 : -1);
+    }
+}
+
+/* task_close_file
+ *  Descrption: Closes an open descriptor of the running task, leaving
+ *      non-blocking mode first
+ *
+ * 	RETURN:
+ *      what the file's close op returns
+ */
+static int32_t task_close_file(FILE *file) {
+    file_set_nonblock(file, 0);
+    return file->file_ops->close(file);
+}
+
+/* task_dup_file
+ *  Descrption: Makes dst a second descriptor for the file open in src,
+ *      for fork, execute and dup2. A regular file's copy gets its own
+ *      offset, an RTC its own slot with the same rate, and a pipe end
+ *      counts one more descriptor
+ *  Arg:
+ *      dst: an unused descriptor
+ *      src: a descriptor, open or not
+ *
+ * 	RETURN:
+ *      0 on success, -1 if an RTC slot couldn't be had; dst is left
+ *      unused then
+ */
+static int32_t task_dup_file(FILE *dst, FILE *src) {
+    *dst = *src;
+    if (!src->flags.used) {
+        return 0;
+    }
+    switch (src->flags.type) {
+        case TASK_FILE_RTC:
+            if (rtc_open(NULL, dst) == -1) {
+                dst->flags.used = 0;
+                return -1;
+            }
+            dst->inode = src->inode;
+            dst->pos = src->pos;
+            break;
+        case TASK_FILE_PIPE:
+            pipe_dup(dst);
+            break;
+        default:
+            break;
+    }
+    // The copy waits for the file too
+    if (dst->flags.nonblock && dst->file_ops->poll_wait) {
+        dst->file_ops->poll_wait(dst, 1);
+    }
+    return 0;
+}
+
+/* task_release
+ *  Descrption: Returns a task's user frames, page tables and kernel stack
+ *      to the frame allocator. Called by the scheduler once the task has
+ *      been switched away from for good, since until then it is still
+ *      running on them
+ */
+void task_release(PCB_t *task_pcb) {
+    page_release_task(task_pcb->user_pt);
+    frame_free((uint32_t) task_pcb->user_pt);
+    frame_free((uint32_t) task_pcb->mmap_pt);
+    frame_free((uint32_t) task_pcb->page_dir);
+    frame_free_range((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
+}
 
 int32_t syscall_halt(uint8_t status) {
     return _syscall_halt(status, (hw_context_t *) (((uint32_t *) &status) + 3));
@@ -17,49 +302,51 @@ int32_t _syscall_halt(uint32_t status, hw_context_t *context) {
     // Revert info from PCB
     PCB_t *task_pcb = get_cur_pcb();
     PCB_t *parent_pcb = task_pcb->parent;
-    if (!parent_pcb) {
+    PCB_t *next_pcb;
+    if (!parent_pcb && !task_pcb->forked) {
         uint32_t entry_addr;
+        mmap_release_all(task_pcb);
+        io_ring_release(task_pcb);
+        fpu_release(task_pcb);
         entry_addr = *((int32_t *) (TASK_IMG_START_ADDR + ELF_ENTRY_OFFSET));
         context->addr = (void *) entry_addr;
         context->esp = (void *) TASK_VIRT_PAGE_END;
         return 0;
     }
 
+    // stdin and stdout too, which may be pipes; closing a terminal does
+    // nothing
     uint8_t i;
-    for (i = 2; i < TASK_MAX_FILES; i ++) {
+    for (i = 0; i < TASK_MAX_FILES; i ++) {
         if (task_pcb->open_files[i].flags.used) {
-            task_pcb->open_files[i].file_ops->close(&task_pcb->open_files[i]);
+            task_close_file(&task_pcb->open_files[i]);
         }
     }
 
-    int32_t ppid = parent_pcb->pid;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(ppid);
-    tss.esp0 = TASK_KSTACK_BOT(ppid);
-    // Reload the TLB
-    asm volatile(
-        "movl %%cr3, %%eax;"
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-        :"%eax"
-    );
+    mmap_release_all(task_pcb);
+    io_ring_release(task_pcb);
+    fpu_release(task_pcb);
+    task_pcbs[task_pcb->pid] = NULL;
+
+    if (task_pcb->forked) {
+        // Nobody waits for a forked child; run whoever is next
+        next_pcb = sched_pick_next();
+        if (!next_pcb) {
+            next_pcb = SCHED_IDLE_PCB;
+        }
+    } else {
+        if (terms[task_pcb->term_ind].cur_pid == task_pcb->pid) {
+            terms[task_pcb->term_ind].cur_pid = parent_pcb->pid;
+        }
+        parent_pcb->child_status = status;
+        parent_pcb->state = TASK_RUNNABLE;
+        next_pcb = parent_pcb;
+    }
+
+    // Still running on this stack and address space; whatever runs next
+    // frees them
+    sched_exit(task_pcb, next_pcb);
 
-    pid_used[task_pcb->pid] = 0;
-    terms[task_pcb->term_ind].cur_pid = ppid;
-    uint32_t prev_ebp = (uint32_t) parent_pcb->ebp;
-    uint32_t prev_esp = (uint32_t) parent_pcb->esp;
-    asm volatile (
-        "xor %%ebx, %%ebx;"
-        "mov %0, %%ebx;"
-        "mov %1, %%eax;"
-        "mov %2, %%ecx;"
-        "mov %%eax, %%ebp;"
-        "mov %%ecx, %%esp;"
-        "jmp 1f;"
-        :
-        : "m" (status), "m" (prev_ebp), "m" (prev_esp)
-        : "%eax", "%ecx", "%ebx"
-    );
     // unreachable!!!
     while (1) { asm volatile ("hlt;"); }
     return 0;
@@ -70,9 +357,10 @@ int32_t syscall_execute(const int8_t *command) {
 }
 
 int32_t _syscall_execute(const int8_t* command, int8_t term_ind) {
+    uint32_t start_tsc = rdtsc_lo();
     int pid;
     for (pid = 1; pid < MAX_PROC_NUM; pid ++) {
-        if (!pid_used[pid]) {
+        if (!task_pcbs[pid]) {
             goto syscall_execute__parse_args;
         }
     }
@@ -97,13 +385,6 @@ syscall_execute__parse_args:;
     strncpy(filename, command, i + 1);
     filename[i] = 0;
 
-    uint8_t arg_len = args ? strlen(args) : 0;
-    int8_t copied_args[arg_len + 1];
-    if (args) {
-        strncpy(copied_args, args, arg_len + 1);
-        copied_args[arg_len] = 0;
-    }
-
     int32_t entry_addr;
     // 3. Check executable format and load task image
     FILE f;
@@ -112,7 +393,11 @@ syscall_execute__parse_args:;
     }
 
     int8_t buf[BUF_SIZE];
-    int32_t read_size = fs_file_read(buf, BUF_SIZE, &f);
+    int32_t hdr_len = fs_file_read(buf, BUF_SIZE, &f);
+    if (hdr_len < ELF_ENTRY_OFFSET + 4) {
+        fs_file_close(&f);
+        return -1;
+    }
     // Check for ELF magic
     if (buf[0] != 0x7F || buf[1] != 'E' || buf[2] != 'L' || buf[3] != 'F') {
         fs_file_close(&f);
@@ -126,97 +411,215 @@ syscall_execute__parse_args:;
         return -1;
     }
 
-    // 4. Setup paging; Set task's target page address
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(pid);
-    // Reload the TLB
-    asm volatile(
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-    );
+    // 4. Get the kernel stack, page directory and page tables
+    PCB_t *task_pcb = task_alloc();
+    if (!task_pcb) {
+        fs_file_close(&f);
+        return -1;
+    }
+
+    // 5. Setup paging; the image itself is only mapped, and each page is
+    // filled in from the page cache the first time it is touched
+    uint32_t img_size = fs_file_size(f.inode);
+    if (img_size > TASK_IMG_MAX_SIZE) {
+        img_size = TASK_IMG_MAX_SIZE;
+    }
+    task_pcb->img_inode = f.inode;
+    task_pcb->img_size = img_size;
+    task_pcb->brk_start = task_image_end(buf, hdr_len, img_size);
+    task_pcb->brk = task_pcb->brk_start;
+    page_setup_task(task_pcb->user_pt, TASK_IMG_START_ADDR, TASK_IMG_START_ADDR + img_size);
 
-    // Copy the rest of the image
-    uint8_t *task_img_cur = (uint8_t *) TASK_IMG_START_ADDR;
-    memcpy(task_img_cur, buf, read_size);
-    task_img_cur += read_size;
-    while ((read_size = fs_file_read(buf, BUF_SIZE, &f)) > 0) {
-        memcpy(task_img_cur, buf, read_size);
-        task_img_cur += read_size;
+#ifdef EXEC_EAGER_LOAD
+    uint32_t page_addr;
+    for (page_addr = TASK_IMG_START_ADDR; page_addr < TASK_IMG_START_ADDR + img_size;
+            page_addr += PAGE_SIZE) {
+        task_fill_page(task_pcb, page_addr);
     }
+#endif
 
     fs_file_close(&f);
 
-    // 5. Setup PCB
+    // 6. Setup PCB
     PCB_t *cur_pcb = get_cur_pcb();
-    PCB_t *task_pcb = (PCB_t *) TASK_KSTACK_TOP(pid);
-    // Open stdin & stdout
-    task_pcb->open_files[0].flags.used = 1;
-    task_pcb->open_files[0].flags.type = TASK_FILE_TERM;
-    task_pcb->open_files[0].file_ops = &stdin_file_ops_table;
-    task_pcb->open_files[1].flags.used = 1;
-    task_pcb->open_files[1].flags.type = TASK_FILE_TERM;
-    task_pcb->open_files[1].file_ops = &stdout_file_ops_table;
+    if (cur_pcb != SCHED_IDLE_PCB && term_ind == -1) {
+        // Programs get the caller's stdin and stdout, so a shell can hand
+        // them pipes; other descriptors aren't passed on
+        task_dup_file(&task_pcb->open_files[0], &cur_pcb->open_files[0]);
+        task_dup_file(&task_pcb->open_files[1], &cur_pcb->open_files[1]);
+        // but blocking, as programs expect
+        file_set_nonblock(&task_pcb->open_files[0], 0);
+        file_set_nonblock(&task_pcb->open_files[1], 0);
+    } else {
+        // Open stdin & stdout
+        task_pcb->open_files[0].flags.used = 1;
+        task_pcb->open_files[0].flags.type = TASK_FILE_TERM;
+        task_pcb->open_files[0].file_ops = &stdin_file_ops_table;
+        task_pcb->open_files[1].flags.used = 1;
+        task_pcb->open_files[1].flags.type = TASK_FILE_TERM;
+        task_pcb->open_files[1].file_ops = &stdout_file_ops_table;
+        task_pcb->open_files[0].flags.nonblock = 0;
+        task_pcb->open_files[1].flags.nonblock = 0;
+        task_pcb->open_files[0].flags.append = 0;
+        task_pcb->open_files[1].flags.append = 0;
+    }
 
     for (i = 2; i < TASK_MAX_FILES; i ++) {
         task_pcb->open_files[i].flags.used = 0;
     }
 
-    task_pcb->cmd_args = args ? copied_args : NULL;
-    asm volatile ("movl %%ebp, %0;" : "=r" (cur_pcb->ebp));
-    asm volatile ("movl %%esp, %0;" : "=r" (cur_pcb->esp));
-    if (cur_pcb != (PCB_t *) TASK_KSTACK_TOP(0) && term_ind == -1) {
+    // The arguments are kept in the PCB; a terminal's shell outlives this call
+    if (args) {
+        strncpy(task_pcb->cmd_args, args, BUF_SIZE - 1);
+        task_pcb->cmd_args[BUF_SIZE - 1] = 0;
+    } else {
+        task_pcb->cmd_args[0] = 0;
+    }
+    if (cur_pcb != SCHED_IDLE_PCB && term_ind == -1) {
         task_pcb->parent = cur_pcb;
     } else {
         task_pcb->parent = NULL;
     }
     task_pcb->pid = pid;
+    task_pcb->state = TASK_RUNNABLE;
+    task_pcb->on_rq = 0;
+    task_pcb->cpu = cur_pcb->cpu;
+    task_pcb->on_cpu = 0;
+    task_pcb->sched_key = 0;
+    // Programs started from a niced task keep its priority
+    task_pcb->nice = task_pcb->parent ? task_pcb->parent->nice : 0;
+    task_pcb->sched_level = task_pcb->nice;
+    task_pcb->run_ticks = 0;
+    task_pcb->cpu_cycles = 0;
+    task_pcb->fpu_used = 0;
+    task_pcb->fpu_cpu = FPU_NO_CPU;
+    task_pcb->forked = 0;
     task_pcb->signals = 0;
-    task_pcb->malloc_obj_count = 1;
     task_pcb->term_ind = term_ind != -1 ? term_ind : cur_pcb->term_ind;
-    malloc_objs[0].used = 0;
-    malloc_objs[0].size = MALLOC_HEAP_SIZE;
 
     if (term_ind != -1) {
         terms[(int) term_ind].cur_pid = pid;
-    } else {
+    } else if (terms[cur_pcb->term_ind].cur_pid == cur_pcb->pid) {
+        // Only the terminal's foreground task hands it on. What a forked
+        // task runs, such as the left side of a shell pipe, stays in the
+        // background, or its halt would hand the terminal to the fork
         terms[cur_pcb->term_ind].cur_pid = pid;
     }
 
-    tss.esp0 = TASK_KSTACK_BOT(pid);
-    tss.ss0 = KERNEL_DS;
-
-    pid_used[pid] = 1;
-
     for (i = 0; i < SIG_SIZE; i ++) {
         task_pcb->signal_handlers[i] = NULL;
     }
 
-    // 6. Context switch
-    asm volatile (
-        "movl %0, %%eax;"  // User DS
-        "movw %%ax, %%ds;"
-        "movw %%ax, %%es;"
-        "movw %%ax, %%fs;"
-        "movw %%ax, %%gs;"
-        "push %%eax;"
-        "movl %1, %%eax;" // User ESP
-        "push %%eax;"
-        "pushf;"
-        "orl $0x200, (%%esp);"
-        "movl %2, %%eax;" // User CS
-        "push %%eax;"
-        "movl %3, %%eax;" // Entry point
-        "push %%eax;"
-        "iret;"
-"1:;"
-        :
-        : "r" (USER_DS), "r" (TASK_VIRT_PAGE_END), "r" (USER_CS), "r" (entry_addr)
-        : "%eax"
-    );
+    for (i = 0; i < TASK_MAX_MMAPS; i ++) {
+        task_pcb->mmaps[i].npages = 0;
+    }
+    task_pcb->io_ring = NULL;
+
+    task_pcb->exec_tsc = start_tsc;
+
+    // 7. Build the context the task enters user space with
+    hw_context_t context;
+    memset(&context, 0, sizeof(context));
+    context.regs[HW_CONTEXT_DS] = USER_DS;
+    context.regs[HW_CONTEXT_ES] = USER_DS;
+    context.regs[HW_CONTEXT_FS] = USER_DS;
+    context.addr = (void *) entry_addr;
+    context.cs = USER_CS;
+    context.eflags = EFLAGS_IF;
+    context.esp = (void *) TASK_VIRT_PAGE_END;
+    context.ds = USER_DS;
+    task_init_kstack(task_pcb, &context);
+    task_pcbs[pid] = task_pcb;
+
+    // A terminal's first shell just joins the run queue
+    if (term_ind != -1) {
+        sched_enqueue(task_pcb);
+        return pid;
+    }
+
+    // 8. Run the child until it halts
+    cur_pcb->state = TASK_WAITING;
+    sched_switch(cur_pcb, task_pcb);
+    return cur_pcb->child_status;
+}
 
-    int32_t retval;
-    asm volatile ("movl %%ebx, %0;" : "=r" (retval));
-    return retval;
+/* _syscall_fork
+ *  Descrption: Duplicates the calling task. The child gets a copy of the
+ *      PCB and open file table, and shares every user page with the parent
+ *      copy-on-write; it returns 0 from the same syscall while the parent
+ *      gets the child's pid
+ *
+ *  Arg:
+ *      context: the parent's saved user registers
+ *
+ * 	RETURN:
+ *      the child's pid, or -1 if there is no free pid or memory ran out
+ */
+int32_t _syscall_fork(hw_context_t *context) {
+    PCB_t *cur_pcb = get_cur_pcb();
+    PCB_t *child_pcb;
+    int pid;
+    for (pid = 1; pid < MAX_PROC_NUM; pid ++) {
+        if (!task_pcbs[pid]) {
+            break;
+        }
+    }
+    if (pid == MAX_PROC_NUM) {
+        return -1;      // No usable pid
+    }
+
+    child_pcb = task_alloc();
+    if (!child_pcb) {
+        return -1;
+    }
+    PDE_t *page_dir = child_pcb->page_dir;
+    PTE_t *user_pt = child_pcb->user_pt;
+    PTE_t *mmap_pt = child_pcb->mmap_pt;
+    // The child starts with the parent's FPU registers
+    fpu_save(cur_pcb);
+    *child_pcb = *cur_pcb;
+    child_pcb->page_dir = page_dir;
+    child_pcb->user_pt = user_pt;
+    child_pcb->mmap_pt = mmap_pt;
+    child_pcb->parent = cur_pcb;
+    child_pcb->pid = pid;
+    child_pcb->on_rq = 0;
+    child_pcb->on_cpu = 0;
+    child_pcb->fpu_cpu = FPU_NO_CPU;
+    child_pcb->run_ticks = 0;
+    child_pcb->cpu_cycles = 0;
+    child_pcb->forked = 1;
+    child_pcb->signals = 0;
+    child_pcb->exec_tsc = 0;
+
+    // Regular files get their own offset; an RTC needs its own slot
+    int i;
+    for (i = 0; i < TASK_MAX_FILES; i ++) {
+        task_dup_file(&child_pcb->open_files[i], &cur_pcb->open_files[i]);
+    }
+
+    // mmap pages are read-only file blocks, so the table is simply copied;
+    // the ring's page is the one exception, and the child starts without
+    memcpy(mmap_pt, cur_pcb->mmap_pt, PAGE_SIZE);
+    for (i = 0; i < TASK_MAX_MMAPS; i ++) {
+        if (child_pcb->mmaps[i].npages) {
+            fs_map_get(child_pcb->mmaps[i].inode);
+        }
+    }
+    if (cur_pcb->io_ring) {
+        clear_pte(&mmap_pt[cur_pcb->io_ring->pte_index]);
+        child_pcb->io_ring = NULL;
+    }
+    page_fork_task(user_pt, cur_pcb->user_pt);
+    // The parent's writable pages just became read-only
+    flush_tlb_user();
+
+    hw_context_t child_context = *context;
+    child_context.regs[HW_CONTEXT_EAX] = 0;
+    task_init_kstack(child_pcb, &child_context);
+    task_pcbs[pid] = child_pcb;
+    sched_enqueue(child_pcb);
+    return pid;
 }
 
 int32_t syscall_read(int32_t fd, void *buf, uint32_t nbytes) {
@@ -249,6 +652,20 @@ int32_t syscall_write(int32_t fd, const void *buf, uint32_t nbytes) {
     if (!task_pcb->open_files[fd].flags.used) {
         return -1;
     }
+    if (task_pcb->exec_tsc && task_pcb->open_files[fd].flags.type == TASK_FILE_TERM) {
+        // First output since execute; record how long the program took to
+        // get here
+        uint32_t cycles = rdtsc_lo() - task_pcb->exec_tsc;
+        task_pcb->exec_tsc = 0;
+        exec_stats.last_cycles = cycles;
+        if (!exec_stats.execs || cycles < exec_stats.min_cycles) {
+            exec_stats.min_cycles = cycles;
+        }
+        if (cycles > exec_stats.max_cycles) {
+            exec_stats.max_cycles = cycles;
+        }
+        exec_stats.execs ++;
+    }
     return task_pcb->open_files[fd].file_ops->write(
             buf, nbytes, &task_pcb->open_files[fd]);
 }
@@ -265,7 +682,26 @@ int32_t syscall_write(int32_t fd, const void *buf, uint32_t nbytes) {
  *      -1 if failed.
  */
 int32_t syscall_open(const int8_t* filename) {
+    return syscall_open_flags(filename, 0);
+}
+
+/* syscall_open_flags
+ *  Descrption: open, with descriptor flags set from the start. open itself
+ *      can't take them, since programs built before it had any pass
+ *      whatever is in the register
+ *
+ *  Arg:
+ *      filename: name of the target file
+ *      flags: any of FD_NONBLOCK and FD_APPEND, or 0
+ *
+ * 	RETURN:
+ *      as for open
+ */
+int32_t syscall_open_flags(const int8_t* filename, int32_t flags) {
     dentry_t dent;
+    if (flags & ~FD_ALL) {
+        return -1;
+    }
     if( read_dentry_by_name(filename, &dent) != 0 ){
         return -1;
     }
@@ -286,6 +722,9 @@ int32_t syscall_open(const int8_t* filename) {
                 return -1;
             }
             task_pcb->open_files[i].flags.used = 1;
+            task_pcb->open_files[i].flags.nonblock = 0;
+            file_set_nonblock(&task_pcb->open_files[i], !!(flags & FD_NONBLOCK));
+            task_pcb->open_files[i].flags.append = !!(flags & FD_APPEND);
             return i;
         }
     }
@@ -302,7 +741,7 @@ int32_t syscall_close(int32_t fd) {
         return -1;
     }
 
-    if (task_pcb->open_files[fd].file_ops->close(&task_pcb->open_files[fd])) {
+    if (task_close_file(&task_pcb->open_files[fd])) {
         return -1;
     }
 
@@ -315,7 +754,7 @@ int32_t syscall_getargs(int8_t* buf, uint32_t nbytes) {
         return -1;
     }
     PCB_t *task_pcb = get_cur_pcb();
-    if (!task_pcb->cmd_args) {
+    if (!task_pcb->cmd_args[0]) {
         return -1;
     }
 
@@ -364,78 +803,503 @@ int32_t _syscall_sigreturn(hw_context_t *context) {
 }
 
 uint8_t *syscall_malloc(uint32_t size) {
-    uint8_t *obj_ptr = (uint8_t *) HEAP_START;
-    int16_t i;
-    uint32_t total_empty_size = 0;
+    return heap_alloc(size);
+}
+
+int32_t syscall_free(uint8_t *ptr) {
+    return heap_free(ptr);
+}
+
+/* syscall_mmap
+ *  Descrption: Maps a regular file read-only into the caller's mmap area.
+ *      The file system image is already in memory, so the data blocks
+ *      themselves are mapped and nothing is copied. The mapping shows the
+ *      blocks the file had when it was mapped; creating the file again,
+ *      which would free them, fails until every mapping is gone.
+ *
+ *  Arg:
+ *      fd: descriptor of an open regular file
+ *      length: if not NULL, receives the size of the file in bytes
+ *
+ * 	RETURN:
+ *      the user address of the first byte of the file, -1 if failed.
+ */
+int32_t syscall_mmap(int32_t fd, uint32_t *length) {
+    if (fd < 0 || fd >= TASK_MAX_FILES) {
+        return -1;
+    }
+    if (length && ((uint32_t) length < TASK_VIRT_PAGE_BEG
+                || (uint32_t) length >= TASK_VIRT_PAGE_END)) {
+        return -1;
+    }
+
     PCB_t *task_pcb = get_cur_pcb();
-    for (i = 0; i < task_pcb->malloc_obj_count; i ++) {
-        uint32_t obj_block_size = malloc_objs[i].size;
-        uint32_t obj_size = obj_block_size * MALLOC_BLOCK_SIZE;
-        if (!malloc_objs[i].used) {
-            if (size < obj_size) {
-                if (task_pcb->malloc_obj_count == MALLOC_OBJ_NUM) {
-                    return NULL;
-                }
-                int16_t j;
-                for (j = task_pcb->malloc_obj_count; j >= i; j --) {
-                    malloc_objs[j + 1] = malloc_objs[j];
-                }
-                malloc_objs[i].used = 1;
-                malloc_objs[i].size = (size / 32) + 1;
-                malloc_objs[i + 1].size = obj_block_size - malloc_objs[i].size;
-                task_pcb->malloc_obj_count ++;
-                return obj_ptr;
+    FILE *file = &task_pcb->open_files[fd];
+    if (!file->flags.used || file->flags.type != TASK_FILE_REG) {
+        return -1;
+    }
+
+    uint32_t size = fs_file_size(file->inode);
+    uint32_t npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (!npages) {
+        return -1;
+    }
+
+    int slot;
+    for (slot = 0; slot < TASK_MAX_MMAPS; slot ++) {
+        if (!task_pcb->mmaps[slot].npages) {
+            break;
+        }
+    }
+    if (slot == TASK_MAX_MMAPS) {
+        return -1;
+    }
+
+    // First fit over the task's mmap page table
+    PTE_t *table = task_pcb->mmap_pt;
+    uint32_t start, run = 0;
+    for (start = 0; start < MAX_ENTRIES && run < npages; start ++) {
+        run = table[start].present ? 0 : run + 1;
+    }
+    if (run < npages) {
+        return -1;
+    }
+    start -= npages;
+
+    uint32_t i;
+    for (i = 0; i < npages; i ++) {
+        uint32_t block_addr = fs_block_addr(file->inode, i);
+        if (!block_addr) {
+            while (i > 0) {
+                clear_pte(&table[start + --i]);
             }
-            if (size > obj_size) {
-                total_empty_size += obj_size;
-                goto probe_next_obj;
+            return -1;
+        }
+        // Blocks are page aligned: the boot loader page-aligns modules
+        set_pte(&table[start + i], block_addr, 1, 0);
+    }
+    task_pcb->mmaps[slot].start = start;
+    task_pcb->mmaps[slot].npages = npages;
+    task_pcb->mmaps[slot].inode = file->inode;
+    fs_map_get(file->inode);
+
+    if (length) {
+        *length = size;
+    }
+    return TASK_MMAP_START + start * PAGE_SIZE;
+}
+
+/* syscall_munmap
+ *  Descrption: Removes a mapping made by syscall_mmap
+ *
+ *  Arg:
+ *      addr: the address mmap returned
+ *
+ * 	RETURN:
+ *      0 on success, -1 if addr is not the start of a mapping.
+ */
+int32_t syscall_munmap(void *addr) {
+    uint32_t virt_addr = (uint32_t) addr;
+    if (virt_addr < TASK_MMAP_START || virt_addr >= TASK_MMAP_END) {
+        return -1;
+    }
+
+    PCB_t *task_pcb = get_cur_pcb();
+    PTE_t *table = task_pcb->mmap_pt;
+    uint16_t start = PAGE_TABLE_INDEX(virt_addr);
+    int slot;
+    for (slot = 0; slot < TASK_MAX_MMAPS; slot ++) {
+        mmap_region_t *region = &task_pcb->mmaps[slot];
+        if (region->npages && region->start == start) {
+            uint32_t i;
+            for (i = start; i < start + region->npages; i ++) {
+                clear_pte(&table[i]);
+                flush_tlb_page(TASK_MMAP_START + i * PAGE_SIZE);
             }
+            region->npages = 0;
+            fs_map_put(region->inode);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* syscall_sbrk
+ *  Descrption: Moves the program break by whole pages. New pages are
+ *      demand-zero like the rest of the user region; pages given back are
+ *      unmapped and their frames freed
+ *
+ *  Arg:
+ *      npages: number of pages to grow (or, if negative, shrink) the heap
+ *
+ * 	RETURN:
+ *      the old break, or -1 if the break would leave
+ *      [brk_start, TASK_BRK_LIMIT]
+ */
+int32_t syscall_sbrk(int32_t npages) {
+    PCB_t *task_pcb = get_cur_pcb();
+    uint32_t old_brk = task_pcb->brk;
+    uint32_t addr;
 
-            malloc_objs[i].used = 1;
-            return obj_ptr;
+    if (npages >= 0) {
+        if (npages > (TASK_BRK_LIMIT - old_brk) / PAGE_SIZE) {
+            return -1;
         }
-probe_next_obj:
-        obj_ptr += malloc_objs[i].size * MALLOC_BLOCK_SIZE;
+        task_pcb->brk += npages * PAGE_SIZE;
+        return old_brk;
     }
 
-    return NULL;
+    if (-npages > (old_brk - task_pcb->brk_start) / PAGE_SIZE) {
+        return -1;
+    }
+    task_pcb->brk -= -npages * PAGE_SIZE;
+    for (addr = task_pcb->brk; addr < old_brk; addr += PAGE_SIZE) {
+        PTE_t *pte = &task_pcb->user_pt[PAGE_TABLE_INDEX(addr)];
+        if (pte->present) {
+            frame_free(pte->page_addr << ADDRESS_SHIFT);
+            clear_pte(pte);
+            flush_tlb_page(addr);
+        }
+    }
+    return old_brk;
 }
 
-int32_t syscall_free(uint8_t *ptr) {
-    if (!ptr) {
-        return 0;
+/* syscall_setsched
+ *  Descrption: Switches the scheduling policy for the whole system
+ *
+ *  Arg:
+ *      policy: SCHED_RR, SCHED_FAIR or SCHED_MLFQ
+ *
+ * 	RETURN:
+ *      the previous policy, or -1 if policy is not valid
+ */
+int32_t syscall_setsched(int32_t policy) {
+    return sched_set_policy(policy);
+}
+
+/* syscall_nice
+ *  Descrption: Sets the calling task's base priority; the MLFQ policy
+ *      never runs it above that level. Children inherit it
+ *
+ *  Arg:
+ *      nice: 0 (the default) up to SCHED_NICE_MAX, the lowest priority
+ *
+ * 	RETURN:
+ *      the previous value, or -1 if nice is not valid
+ */
+int32_t syscall_nice(int32_t nice) {
+    return sched_set_nice(get_cur_pcb(), nice);
+}
+
+/* syscall_batch
+ *  Descrption: Runs several system calls for one trap, in order, through
+ *      the same table int 0x80 uses. Each call's return value goes in its
+ *      result. halt, sigreturn, fork and batch itself aren't allowed and
+ *      fail like an unknown call
+ *
+ *  Arg:
+ *      reqs: the calls, in user memory
+ *      count: number of calls
+ *      flags: BATCH_STOP_ON_ERROR to skip the rest after a call returns -1
+ *
+ * 	RETURN:
+ *      the number of calls run, including one that stopped the batch, or
+ *      -1 if the array is not valid
+ */
+int32_t syscall_batch(syscall_req_t *reqs, uint32_t count, uint32_t flags) {
+    uint32_t i;
+    int32_t num;
+
+    if ((uint32_t) reqs < TASK_VIRT_PAGE_BEG || (uint32_t) reqs >= TASK_VIRT_PAGE_END
+            || count > (TASK_VIRT_PAGE_END - (uint32_t) reqs) / sizeof(syscall_req_t)) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        num = reqs[i].num;
+        if (num < 1 || num > SYSCALL_NUM || (SYSCALL_BATCH_DENY & (1 << num))) {
+            reqs[i].result = -1;
+        } else {
+            reqs[i].result = SYSCALL_JMP_TAB[num - 1](reqs[i].args[0], reqs[i].args[1],
+                    reqs[i].args[2]);
+        }
+        if (reqs[i].result == -1 && (flags & BATCH_STOP_ON_ERROR)) {
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+/* syscall_pipe
+ *  Descrption: Makes a pipe and opens a descriptor on each end
+ *
+ *  Arg:
+ *      fds: gets the read end's descriptor, then the write end's
+ *
+ * 	RETURN:
+ *      0 on success, -1 if there aren't two free descriptors or memory
+ *      ran out
+ */
+int32_t syscall_pipe(int32_t *fds) {
+    if ((uint32_t) fds < TASK_VIRT_PAGE_BEG
+            || (uint32_t) fds > TASK_VIRT_PAGE_END - 2 * sizeof(int32_t)) {
+        return -1;
+    }
+
+    PCB_t *task_pcb = get_cur_pcb();
+    int32_t read_fd, write_fd;
+    for (read_fd = 2; read_fd < TASK_MAX_FILES && task_pcb->open_files[read_fd].flags.used;
+            read_fd ++);
+    for (write_fd = read_fd + 1;
+            write_fd < TASK_MAX_FILES && task_pcb->open_files[write_fd].flags.used;
+            write_fd ++);
+    if (write_fd >= TASK_MAX_FILES) {
+        return -1;
+    }
+
+    if (pipe_create(&task_pcb->open_files[read_fd], &task_pcb->open_files[write_fd])) {
+        return -1;
     }
-    uint8_t *obj_ptr = (uint8_t *) HEAP_START;
-    uint16_t i;
+    task_pcb->open_files[read_fd].flags.used = 1;
+    task_pcb->open_files[read_fd].flags.nonblock = 0;
+    task_pcb->open_files[read_fd].flags.append = 0;
+    task_pcb->open_files[write_fd].flags.used = 1;
+    task_pcb->open_files[write_fd].flags.nonblock = 0;
+    task_pcb->open_files[write_fd].flags.append = 0;
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
+/* syscall_dup2
+ *  Descrption: Makes newfd a second descriptor for what oldfd has open,
+ *      closing whatever newfd had first. This is how a pipe end becomes a
+ *      program's stdin or stdout
+ *
+ *  Arg:
+ *      oldfd: an open descriptor
+ *      newfd: the descriptor to use, or -1 for the lowest unused one from
+ *          2 up, as open would pick
+ *
+ * 	RETURN:
+ *      the new descriptor, or -1 if failed
+ */
+int32_t syscall_dup2(int32_t oldfd, int32_t newfd) {
+    if (oldfd < 0 || oldfd >= TASK_MAX_FILES || newfd < -1 || newfd >= TASK_MAX_FILES) {
+        return -1;
+    }
+
     PCB_t *task_pcb = get_cur_pcb();
-    for (i = 0; i < task_pcb->malloc_obj_count && ptr > obj_ptr; i ++) {
-        obj_ptr += malloc_objs[i].size * MALLOC_BLOCK_SIZE;
+    FILE *old_file = &task_pcb->open_files[oldfd];
+    if (!old_file->flags.used) {
+        return -1;
+    }
+    if (newfd == -1) {
+        for (newfd = 2; newfd < TASK_MAX_FILES && task_pcb->open_files[newfd].flags.used;
+                newfd ++);
+        if (newfd == TASK_MAX_FILES) {
+            return -1;
+        }
     }
-    if (obj_ptr != ptr) {
+    if (newfd == oldfd) {
+        return newfd;
+    }
+
+    FILE *new_file = &task_pcb->open_files[newfd];
+    if (new_file->flags.used) {
+        // A terminal's close always fails but has nothing to undo
+        task_close_file(new_file);
+        new_file->flags.used = 0;
+    }
+    if (task_dup_file(new_file, old_file)) {
         return -1;
     }
+    return newfd;
+}
 
-    uint16_t empty_size = malloc_objs[i].size;
-    uint8_t move = 0;
-    if (i < task_pcb->malloc_obj_count && !malloc_objs[i + 1].used) {
-        move ++;
-        empty_size += malloc_objs[i + 1].size;
+/* syscall_fcntl
+ *  Descrption: Reads or changes a descriptor's flags. They belong to the
+ *      descriptor, so copies made by fork or dup2 keep theirs
+ *
+ *  Arg:
+ *      fd: an open descriptor
+ *      cmd: FCNTL_GETFL, FCNTL_SETFL to replace the flags with arg, or
+ *          FCNTL_ISTERM to ask whether the descriptor is a terminal
+ *      arg: any of FD_NONBLOCK and FD_APPEND, or 0, for FCNTL_SETFL
+ *
+ * 	RETURN:
+ *      the flags for FCNTL_GETFL, 0 for FCNTL_SETFL, 1 or 0 for
+ *      FCNTL_ISTERM, or -1 if failed
+ */
+int32_t syscall_fcntl(int32_t fd, int32_t cmd, int32_t arg) {
+    if (fd < 0 || fd >= TASK_MAX_FILES) {
+        return -1;
     }
-    if (i > 0 && malloc_objs[i - 1].used == 0) {
-        move ++;
-        empty_size += malloc_objs[i + 1].size;
-        i --;
+
+    PCB_t *task_pcb = get_cur_pcb();
+    FILE *file = &task_pcb->open_files[fd];
+    if (!file->flags.used) {
+        return -1;
+    }
+    switch (cmd) {
+        case FCNTL_GETFL:
+            return (file->flags.nonblock ? FD_NONBLOCK : 0)
+                | (file->flags.append ? FD_APPEND : 0);
+        case FCNTL_SETFL:
+            if (arg & ~FD_ALL) {
+                return -1;
+            }
+            file_set_nonblock(file, !!(arg & FD_NONBLOCK));
+            file->flags.append = !!(arg & FD_APPEND);
+            return 0;
+        case FCNTL_ISTERM:
+            return file->flags.type == TASK_FILE_TERM;
     }
+    return -1;
+}
 
-    task_pcb->malloc_obj_count -= move;
-    uint16_t j;
-    for (j = i + 1; j < task_pcb->malloc_obj_count; j ++) {
-        malloc_objs[j] = malloc_objs[j + move];
+/* syscall_poll
+ *  Descrption: Waits for any of several descriptors, so one task can take
+ *      keys and RTC ticks as they come. The set is copied in, so pages
+ *      shared with a forked task are only written once the wait is over
+ *
+ *  Arg:
+ *      fds: the descriptors and the events wanted; revents is filled in
+ *      nfds: how many, up to IO_POLL_MAX
+ *      timeout: 0 to only check, negative to wait until one is ready
+ *
+ * 	RETURN:
+ *      the number of descriptors with revents set, or -1 if failed
+ */
+int32_t syscall_poll(poll_fd_t *fds, uint32_t nfds, int32_t timeout) {
+    if ((uint32_t) fds < TASK_VIRT_PAGE_BEG || (uint32_t) fds >= TASK_VIRT_PAGE_END
+            || nfds > (TASK_VIRT_PAGE_END - (uint32_t) fds) / sizeof(poll_fd_t)
+            || nfds > IO_POLL_MAX) {
+        return -1;
     }
-    malloc_objs[i].used = 0;
-    malloc_objs[i].size = empty_size;
 
-    return 0;
+    poll_fd_t kfds[IO_POLL_MAX];
+    int32_t nready;
+    memcpy(kfds, fds, nfds * sizeof(poll_fd_t));
+    if ((nready = io_poll(get_cur_pcb(), kfds, nfds, timeout)) == -1) {
+        return -1;
+    }
+    memcpy(fds, kfds, nfds * sizeof(poll_fd_t));
+    return nready;
+}
+
+/* syscall_io_setup
+ *  Descrption: Gives the caller an asynchronous I/O ring (see io_ring.h)
+ *
+ * 	RETURN:
+ *      the user address of the shared ring page, or -1 if the caller
+ *      already has one or memory ran out
+ */
+int32_t syscall_io_setup(void) {
+    return io_ring_setup(get_cur_pcb());
+}
+
+/* syscall_io_enter
+ *  Descrption: Submits new ops from the caller's ring and waits for
+ *      completions, in one call
+ *
+ *  Arg:
+ *      to_submit: most submissions to take off the ring
+ *      min_complete: completions to wait for
+ *
+ * 	RETURN:
+ *      the number of submissions taken, or -1 if the caller has no ring
+ */
+int32_t syscall_io_enter(uint32_t to_submit, uint32_t min_complete) {
+    return io_ring_enter(get_cur_pcb(), to_submit, min_complete);
+}
+
+/* mmap_release_all
+ *  Descrption: Drops every mapping of the running task, when it exits or
+ *      the root shell restarts. Each page is flushed as munmap does, since
+ *      the restart returns to user mode without reloading CR3 and the
+ *      blocks may go to another file once the map count drops
+ */
+void mmap_release_all(PCB_t *task_pcb) {
+    PTE_t *table = task_pcb->mmap_pt;
+    int slot;
+    for (slot = 0; slot < TASK_MAX_MMAPS; slot ++) {
+        mmap_region_t *region = &task_pcb->mmaps[slot];
+        uint32_t i;
+        if (!region->npages) {
+            continue;
+        }
+        for (i = region->start; i < region->start + region->npages; i ++) {
+            clear_pte(&table[i]);
+            flush_tlb_page(TASK_MMAP_START + i * PAGE_SIZE);
+        }
+        region->npages = 0;
+        fs_map_put(region->inode);
+    }
+}
+
+int32_t syscall_kstat(int32_t type, void *buf, uint32_t nbytes) {
+    if (!buf) {
+        return -1;
+    }
+
+    switch (type) {
+        case KSTAT_PAGE_CACHE:
+            if (nbytes < sizeof(page_cache_stats_t)) {
+                return -1;
+            }
+            page_cache_get_stats((page_cache_stats_t *) buf);
+            return sizeof(page_cache_stats_t);
+        case KSTAT_EXEC:
+            if (nbytes < sizeof(exec_stats_t)) {
+                return -1;
+            }
+            memcpy(buf, &exec_stats, sizeof(exec_stats_t));
+            return sizeof(exec_stats_t);
+        case KSTAT_FRAMES:
+            if (nbytes < sizeof(frame_stats_t)) {
+                return -1;
+            }
+            frame_get_stats((frame_stats_t *) buf);
+            return sizeof(frame_stats_t);
+        case KSTAT_SWITCH:
+            if (nbytes < sizeof(switch_stats_t)) {
+                return -1;
+            }
+            sched_get_stats((switch_stats_t *) buf);
+            return sizeof(switch_stats_t);
+        case KSTAT_MALLOC:
+            if (nbytes < sizeof(malloc_stats_t)) {
+                return -1;
+            }
+            heap_get_stats((malloc_stats_t *) buf);
+            return sizeof(malloc_stats_t);
+        case KSTAT_TASKS:
+            if (nbytes < sizeof(task_stat_t)) {
+                return -1;
+            }
+            return sched_get_task_stats((task_stat_t *) buf, nbytes / sizeof(task_stat_t))
+                * sizeof(task_stat_t);
+        case KSTAT_INPUT:
+            if (nbytes < sizeof(input_stats_t)) {
+                return -1;
+            }
+            term_get_input_stats(get_cur_pcb()->term_ind, (input_stats_t *) buf);
+            return sizeof(input_stats_t);
+        case KSTAT_IRQ:
+            if (nbytes < sizeof(irq_stats_t)) {
+                return -1;
+            }
+            irq_get_stats((irq_stats_t *) buf);
+            return sizeof(irq_stats_t);
+        case KSTAT_CPUS:
+            if (nbytes < sizeof(cpu_stats_t)) {
+                return -1;
+            }
+            sched_get_cpu_stats((cpu_stats_t *) buf);
+            return sizeof(cpu_stats_t);
+    }
+    return -1;
 }
 
 PCB_t *get_cur_pcb() {
@@ -4,26 +4,63 @@
 #include "types.h"
 #include "task.h"
 #include "signals.h"
-
-// Each block has a size of 32-bytes, and the allocator will only allocate
-// multiples of blocks
-// Total amount of heap is 256K, so it doesn't collide with program code
-// A size of 0 means it has *1* block; used blocks can be ajacent to each
-// other (as they represent deifferent allocated objects), but unused
-// blocks can't. Each object can only have 1 block.
-#define MALLOC_MAP_SIZE 4096
-#define MALLOC_HEAP_SIZE (256 * 1024 / 32)
-#define MALLOC_OBJ_NUM 2048
-#define MALLOC_BLOCK_SIZE 32
-#define MALLOC_HEAP_MAP_START (TASK_VIRT_PAGE_BEG + PCB_SIZE)
-#define HEAP_START (TASK_VIRT_PAGE_BEG + PCB_SIZE + MALLOC_MAP_SIZE)
-#define PCB_SIZE sizeof(PCB_t)
+#include "io_ring.h"
 
 #define ELF_ENTRY_OFFSET 24
+// Program header table location and size in the ELF header
+#define ELF_PHOFF_OFFSET 28
+#define ELF_PHENTSIZE_OFFSET 42
+#define ELF_PHNUM_OFFSET 44
+// Fields of a program header
+#define ELF_PH_TYPE_OFFSET 0
+#define ELF_PH_VADDR_OFFSET 8
+#define ELF_PH_MEMSZ_OFFSET 20
+#define ELF_PT_LOAD 1
+// Define to copy the whole image in execute instead of faulting it in page
+// by page; kept for comparing exec latency
+/* #define EXEC_EAGER_LOAD */
+
+// Kernel statistics that can be queried with kstat
+#define KSTAT_PAGE_CACHE 0
+#define KSTAT_EXEC       1
+#define KSTAT_FRAMES     2
+#define KSTAT_SWITCH     3
+#define KSTAT_MALLOC     4
+#define KSTAT_TASKS      5
+#define KSTAT_INPUT      6
+#define KSTAT_IRQ        7
+#define KSTAT_CPUS       8
+
+// Descriptor flags, given to open_flags or set with fcntl
+#define FD_NONBLOCK      0x1
+#define FD_APPEND        0x2
+#define FD_ALL           (FD_NONBLOCK | FD_APPEND)
+// fcntl commands
+#define FCNTL_GETFL      0
+#define FCNTL_SETFL      1
+#define FCNTL_ISTERM     2
+// Returned by read and write on a non-blocking descriptor that isn't ready
+#define SYSCALL_WOULD_BLOCK (-2)
+
+// syscall_batch flags
+#define BATCH_STOP_ON_ERROR 0x1
+
+// One call of a batch; the kernel fills in result
+typedef struct {
+    int32_t num;
+    int32_t args[3];
+    int32_t result;
+} syscall_req_t;
+
+// Latencies are TSC cycles from the start of execute to the program's
+// first write to the terminal
 typedef struct {
-    uint16_t used : 1;
-    uint16_t size : 15;
-} __attribute__((packed)) malloc_obj_t;
+    uint32_t execs;
+    uint32_t image_pages;   // image pages copied in from the page cache
+    uint32_t last_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+} exec_stats_t;
 
 int32_t syscall_halt(uint8_t status);
 int32_t _syscall_halt(uint32_t status, hw_context_t *context);
@@ -38,9 +75,29 @@ int32_t syscall_vidmap(uint8_t **screen_start);
 int32_t syscall_set_handler(int32_t signum, void *handler);
 extern int32_t syscall_sigreturn(void);
 int32_t _syscall_sigreturn(hw_context_t *context);
+extern int32_t syscall_fork(void);
+int32_t _syscall_fork(hw_context_t *context);
 uint8_t *syscall_malloc(uint32_t size);
 int32_t syscall_free(uint8_t *ptr);
+int32_t syscall_kstat(int32_t type, void *buf, uint32_t nbytes);
+int32_t syscall_mmap(int32_t fd, uint32_t *length);
+int32_t syscall_munmap(void *addr);
+int32_t syscall_sbrk(int32_t npages);
+int32_t syscall_setsched(int32_t policy);
+int32_t syscall_nice(int32_t nice);
+int32_t syscall_batch(syscall_req_t *reqs, uint32_t count, uint32_t flags);
+int32_t syscall_io_setup(void);
+int32_t syscall_io_enter(uint32_t to_submit, uint32_t min_complete);
+int32_t syscall_pipe(int32_t *fds);
+int32_t syscall_dup2(int32_t oldfd, int32_t newfd);
+int32_t syscall_poll(poll_fd_t *fds, uint32_t nfds, int32_t timeout);
+int32_t syscall_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+int32_t syscall_open_flags(const int8_t* filename, int32_t flags);
+void mmap_release_all(PCB_t *task_pcb);
+void task_release(PCB_t *task_pcb);
+int32_t task_fault_in(uint32_t addr, uint32_t errorcode);
 PCB_t *get_cur_pcb();
+extern PCB_t *task_pcbs[MAX_PROC_NUM];
 int32_t do_syscall(int32_t call, int32_t a, int32_t b, int32_t c);
 int32_t init_proc(const int8_t* command, int8_t term_ind);
 
@@ -9,31 +9,48 @@
 // Maximum number of files open for each task
 #define TASK_MAX_FILES 8
 #define TASK_MAX_FD    7
-// The starting page index for the first task = 8 MB
-#define TASK_START_PAGE 2
-#define TASK_PAGE_INDEX(c) (TASK_START_PAGE + c)
 
 #define TASK_IMG_START_ADDR 0x08048000
-// Kernel stack top for the task; Also location for PCB
-#define TASK_KSTACK_TOP(c) (0x800000 - 0x2000 * (c + 1))
+#define TASK_IMG_MAX_SIZE (TASK_VIRT_PAGE_END - TASK_IMG_START_ADDR)
+// sbrk grows the heap up from the end of the image to here; the user stack
+// grows down from TASK_VIRT_PAGE_END into the rest
+#define TASK_STACK_MAX_SIZE 0x100000
+#define TASK_BRK_LIMIT (TASK_VIRT_PAGE_END - TASK_STACK_MAX_SIZE)
+// Kernel stacks are 8 KB and 8 KB aligned, with the PCB at the top (lowest
+// address) so it can be found from esp
+#define TASK_KSTACK_SIZE 0x2000
+#define TASK_KSTACK_FRAMES (TASK_KSTACK_SIZE / PAGE_SIZE)
 // Kernel stack bottom (start) for the task
-#define TASK_KSTACK_BOT(c) (0x800000 - 0x2000 * (c))
-// User stack bottom (start) for the task
-#define TASK_USTACK_BOT(c) (0x800000 + 0x40000 * (c + 1))
-#define KSTACK_TOP_MASK (~0x1FFF)
+#define TASK_KSTACK_BOT(pcb) ((uint32_t) (pcb) + TASK_KSTACK_SIZE)
+// The boot stack at the end of the kernel page; its PCB is pid 0's
+#define TASK_BOOT_KSTACK_TOP (0x800000 - TASK_KSTACK_SIZE)
+#define KSTACK_TOP_MASK (~(TASK_KSTACK_SIZE - 1))
+// fxsave area
+#define TASK_FPU_STATE_SIZE 512
 
-#define MAX_PROC_NUM 10
+// Size of the pid table; the tasks' memory itself comes from the frame
+// allocator
+#define MAX_PROC_NUM 128
+// Maximum number of files mapped at the same time by each task
+#define TASK_MAX_MMAPS 8
 
 typedef enum {
     TASK_FILE_REG,
     TASK_FILE_DIR,
     TASK_FILE_RTC,
     TASK_FILE_TERM,
+    TASK_FILE_PIPE,
 } task_file_flags_type_t;
 
 typedef struct {
     task_file_flags_type_t type;
     uint8_t used;
+    // Reads and writes that would sleep fail with SYSCALL_WOULD_BLOCK
+    // instead; each driver checks it under the lock it sleeps with, so
+    // nothing can take the data in between. Set through file_set_nonblock
+    uint8_t nonblock;
+    // Every write to a regular file starts at its current end
+    uint8_t append;
 } file_flags_t;
 
 typedef struct {
@@ -44,25 +61,105 @@ typedef struct {
     file_flags_t flags;
 } FILE;
 
+// What a file's poll op reports a read or write wouldn't sleep for
+#define POLL_IN  0x1
+#define POLL_OUT 0x2
+// Reported by the poll system call for a descriptor that isn't open
+#define POLL_NVAL 0x4
+
 typedef struct file_ops_table {
     int32_t (*open)(const int8_t* filename, FILE *file);
     int32_t (*read)(int8_t* buf, uint32_t nbytes, FILE *file);
     int32_t (*write)(const int8_t* buf, uint32_t nbytes, FILE *file);
     int32_t (*close)(FILE *file);
+    // NULL for files that never make a reader or writer sleep
+    int32_t (*poll)(FILE *file);
+    // Called with 1 before a task waits for the file in poll or an I/O
+    // ring, and with -1 once it stops, for drivers that only take input
+    // while someone waits for it; may be NULL
+    void (*poll_wait)(FILE *file, int32_t delta);
 } file_ops_table_t;
 
+typedef struct {
+    uint16_t start;     // First entry in the task's mmap page table
+    uint16_t npages;    // 0 if the slot is unused
+    int32_t inode;      // The mapped file; it cannot be truncated meanwhile
+} mmap_region_t;
+
+typedef enum {
+    TASK_RUNNABLE,      // Running, or on the run queue
+    TASK_WAITING,       // In execute until its child halts
+    TASK_BLOCKED,       // Asleep on a wait queue
+} task_state_t;
+
+// Tasks asleep until some event, in the order they went to sleep
+typedef struct {
+    struct PCB_s *head;
+    struct PCB_s *tail;
+} wait_queue_t;
+
 typedef struct PCB_s {
     FILE open_files[TASK_MAX_FILES];
     struct PCB_s *parent;
-    const int8_t *cmd_args;
-    uint8_t *esp;
-    uint8_t *ebp;
+    // Empty if the task got no arguments
+    int8_t cmd_args[BUF_SIZE];
+    // Kernel stack pointer saved by context_switch
+    uint8_t *ksp;
+    task_state_t state;
+    // Run queue links, owned by the scheduling policy
+    struct PCB_s *rq_next;
+    struct PCB_s *rq_prev;
+    uint8_t on_rq;
+    // CPU the task runs on, or last ran on; a queued task is on its queue
+    uint8_t cpu;
+    // Set from when a CPU switches to the task until its registers have
+    // been saved on the way out; no other CPU may switch to it until then
+    volatile uint8_t on_cpu;
+    // Ordering key private to the scheduling policy
+    uint32_t sched_key;
+    // MLFQ level; 0 is the highest priority
+    uint8_t sched_level;
+    // The MLFQ boost the level was last brought up to date with
+    uint32_t sched_boost_gen;
+    // Base priority set with nice: the highest level the task may rise to
+    uint8_t nice;
+    // PIT ticks left before the task is preempted
+    uint32_t slice_left;
+    // PIT ticks the task has been running for
+    uint32_t run_ticks;
+    // TSC cycles the task has been running for
+    uint64_t cpu_cycles;
+    // Next task on the same wait queue
+    struct PCB_s *wq_next;
+    // Set for children of fork; the parent doesn't wait for them
+    uint8_t forked;
+    // Status the last child passed to halt
+    int32_t child_status;
     int8_t signals;
     uint8_t pid;
     uint8_t term_ind;
-    // Total number of objects; unused objects are counted
-    uint32_t malloc_obj_count;
     sighandler_t *signal_handlers[SIG_SIZE];
+    mmap_region_t mmaps[TASK_MAX_MMAPS];
+    // Asynchronous I/O ring made by io_setup, or NULL
+    struct io_ring *io_ring;
+    // Frames holding the task's page directory and tables
+    PDE_t *page_dir;
+    PTE_t *user_pt;
+    PTE_t *mmap_pt;
+    // Program image that lazy user pages are filled from
+    int32_t img_inode;
+    uint32_t img_size;
+    // Page aligned program break; sbrk moves brk, starting from brk_start
+    uint32_t brk_start;
+    uint32_t brk;
+    // TSC when execute started; cleared once the task first writes output
+    uint32_t exec_tsc;
+    // Set once the task has used the FPU; fpu_state is only valid then
+    uint8_t fpu_used;
+    // CPU whose registers last had the task's FPU state loaded
+    uint8_t fpu_cpu;
+    // x87 and SSE registers, saved by fxsave while another task owns them
+    uint8_t fpu_state[TASK_FPU_STATE_SIZE] __attribute__ ((aligned (16)));
 } PCB_t;
 
 
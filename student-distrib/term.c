@@ -3,6 +3,8 @@
 #include "lib.h"
 #include "syscall.h"
 #include "page.h"
+#include "scheduling.h"
+#include "io_ring.h"
 
 term_t terms[TERM_NUM];
 uint8_t cur_term_ind = 0;
@@ -10,6 +12,9 @@ static uint8_t* video_mem = (uint8_t *)VIDEO;
 static uint8_t* back_1 = (uint8_t*)0xB9000;
 static uint8_t* back_2 = (uint8_t*)0xBA000;
 static uint8_t* back_3 = (uint8_t*)0xBB000;
+// Keeps the keyboard handler on one CPU and term_read/term_write on the
+// others from working on the same terminal (and cur_term) at once
+static spinlock_t term_lock = SPINLOCK_INIT;
 
 int32_t term_read_invalid(int8_t* buf, uint32_t nbytes, FILE *file) {
     return -1;
@@ -25,6 +30,8 @@ file_ops_table_t stdin_file_ops_table = {
     .read = term_read,
     .write = term_write_invalid,
     .close = term_close,
+    .poll = term_poll,
+    .poll_wait = term_poll_wait,
 };
 
 file_ops_table_t stdout_file_ops_table = {
@@ -52,25 +59,35 @@ int32_t term_read(int8_t* buf, uint32_t nbytes, FILE *file) {
     }
     PCB_t *task_pcb = get_cur_pcb();
     term_t *cur_term = &terms[task_pcb->term_ind];
+    uint32_t flags;
+    // The lock is held from each check to the sleep, so a key can't be
+    // handled in between
+    spin_lock_irqsave(&term_lock, flags);
+    // A non-blocking reader doesn't wait; it is already counted among the
+    // watchers, so keys are kept for it
+    if (file->flags.nonblock
+            && !(cur_term->term_canon ? cur_term->term_buf_count : cur_term->term_read_done)) {
+        spin_unlock_irqrestore(&term_lock, flags);
+        return SYSCALL_WOULD_BLOCK;
+    }
     if (cur_term->term_canon) {
         cur_term->reading = 1;
-        sti();
         while (!cur_term->term_buf_count) {
-            asm volatile ("hlt");
+            sched_boost(task_pcb);
+            sched_sleep(&cur_term->read_wq, &term_lock);
         }
-        cli();
         cur_term->reading = 0;
         memcpy(buf, cur_term->term_buf, 1);
         cur_term->term_curpos = 1;
         delch(cur_term);
+        spin_unlock_irqrestore(&term_lock, flags);
         return 1;
     } else {
         cur_term->reading = 1;
-        sti();
         while (!cur_term->term_read_done) {
-            asm volatile ("hlt");
+            sched_boost(task_pcb);
+            sched_sleep(&cur_term->read_wq, &term_lock);
         }
-        cli();
         cur_term->reading = 0;
         if (!cur_term->term_noecho) {
             putc('\n', cur_term);
@@ -81,10 +98,33 @@ int32_t term_read(int8_t* buf, uint32_t nbytes, FILE *file) {
         cur_term->term_buf_count = 0;
         cur_term->term_read_done = 0;
         cur_term->term_curpos = 0;
+        spin_unlock_irqrestore(&term_lock, flags);
         return copy_count;
     }
 }
 
+// A read returns without sleeping once the same condition term_read waits
+// for holds
+int32_t term_poll(FILE *file) {
+    term_t *cur_term = &terms[get_cur_pcb()->term_ind];
+    uint32_t flags;
+    int32_t ready;
+    spin_lock_irqsave(&term_lock, flags);
+    ready = cur_term->term_canon ? cur_term->term_buf_count : cur_term->term_read_done;
+    spin_unlock_irqrestore(&term_lock, flags);
+    return ready ? POLL_IN : 0;
+}
+
+// Keys are only taken while someone waits for them, so a task waiting in
+// poll or an I/O ring counts as long as it waits
+void term_poll_wait(FILE *file, int32_t delta) {
+    term_t *cur_term = &terms[get_cur_pcb()->term_ind];
+    uint32_t flags;
+    spin_lock_irqsave(&term_lock, flags);
+    cur_term->watchers += delta;
+    spin_unlock_irqrestore(&term_lock, flags);
+}
+
 void esc_funcs(uint8_t f, uint8_t *args, uint8_t arg_len, term_t *cur_term) {
     uint8_t setting = 0;
     switch (f) {
@@ -207,6 +247,8 @@ int8_t esc_parse(uint8_t c, term_t *cur_term) {
 
 int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file) {
     PCB_t *task_pcb = get_cur_pcb();
+    uint32_t flags;
+    spin_lock_irqsave(&term_lock, flags);
     cur_term = &terms[task_pcb->term_ind];
     int i;
     for (i = 0; i < nbytes; i ++) {
@@ -215,6 +257,7 @@ int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file) {
             putc(c, cur_term);
         }
     }
+    spin_unlock_irqrestore(&term_lock, flags);
     return nbytes;
 }
 
@@ -223,8 +266,8 @@ void switch_term(uint8_t ind) {
         return;
     }
 
-    // Save old terminal
-    cli();
+    // Save old terminal; this runs in the keyboard handler, which holds
+    // term_lock
     memcpy(cur_term->video_buffer, video_mem, VID_MEM_SIZE);
     cur_term->video_mem = cur_term->video_buffer;
 
@@ -234,10 +277,55 @@ void switch_term(uint8_t ind) {
     cur_term->video_mem = video_mem;
     setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
     memcpy(video_mem, cur_term->video_buffer, VID_MEM_SIZE);
-    sti();
+
+    // The running task's terminal may have just moved on or off screen
+    // Tasks running on other CPUs pick the change up at their next switch
+    PCB_t *task_pcb = get_cur_pcb();
+    if (task_pcb != SCHED_IDLE_PCB) {
+        page_set_user_vidmem(task_pcb->page_dir, this_cpu()->id, task_pcb->term_ind,
+                task_pcb->term_ind == cur_term_ind);
+    }
 }
 
+static void term_handle_key(key_t key);
+
+// Lets a program measure how long a key takes to reach it
+void term_get_input_stats(uint8_t term_ind, input_stats_t *stats) {
+    uint32_t flags;
+    spin_lock_irqsave(&term_lock, flags);
+    *stats = terms[term_ind].input_stats;
+    spin_unlock_irqrestore(&term_lock, flags);
+}
+
+static uint8_t term_key_locked(key_t key);
+
 void term_key_handler(key_t key) {
+    uint8_t ready;
+    spin_lock(&term_lock);
+    ready = term_key_locked(key);
+    spin_unlock(&term_lock);
+    // Rings waiting on the terminal check it themselves, under their lock
+    if (ready) {
+        io_notify();
+    }
+}
+
+// Returns whether the terminal has something for a reader now
+static uint8_t term_key_locked(key_t key) {
+    term_t *key_term = &terms[cur_term_ind];
+    uint8_t ready;
+    key_term->input_stats.key_tsc = rdtsc();
+    key_term->input_stats.keys++;
+    term_handle_key(key);
+    ready = key_term->term_canon ? key_term->term_buf_count : key_term->term_read_done;
+    // Wake a blocked reader once there is something for it to return
+    if (key_term->reading && ready) {
+        sched_wake_all(&key_term->read_wq);
+    }
+    return ready;
+}
+
+static void term_handle_key(key_t key) {
     cur_term = &terms[cur_term_ind];
     if (cur_term->term_canon
             && !(key.modifiers == MOD_ALT && key.key >= KEY_F1 && key.key <= KEY_F3)) {    // Canonical mode
@@ -318,8 +406,10 @@ void term_key_handler(key_t key) {
             case 'c':      // C-C; keyboard interrupt
                 puts("^C", cur_term);
                 uint8_t cur_pid = terms[cur_term_ind].cur_pid;
-                PCB_t *task_pcb = (PCB_t *) TASK_KSTACK_TOP(cur_pid);
-                task_pcb->signals |= SIG_FLAG(SIG_KB_INT);
+                PCB_t *task_pcb = task_pcbs[cur_pid];
+                if (task_pcb) {
+                    task_pcb->signals |= SIG_FLAG(SIG_KB_INT);
+                }
                 /* term_read_done = 1; */
                 /* term_buf_count = 0; */
                 return;
@@ -374,13 +464,13 @@ void term_key_handler(key_t key) {
         }
     // Use control characters to handle the following keys
     } else if (key.key == KEY_ENTER) {
-        term_key_handler((key_t) C('m'));
+        term_key_locked((key_t) C('m'));
     } else if (key.key == KEY_BACK) {
-        term_key_handler((key_t) C('h'));
+        term_key_locked((key_t) C('h'));
     } else if (key.key == KEY_LEFT) {
-        term_key_handler((key_t) C('b'));
+        term_key_locked((key_t) C('b'));
     } else if (key.key == KEY_RIGHT) {
-        term_key_handler((key_t) C('f'));
+        term_key_locked((key_t) C('f'));
     } else if (key.key >= KEY_F1 && key.key <= KEY_F12) {
         // STUB!
         /* printf("F%d", key.key - KEY_F1); */
@@ -391,7 +481,8 @@ void term_key_handler(key_t key) {
 
 // Add a character to the line buf after the current cursor position
 void addch(uint8_t ch, term_t *cur_term) {
-    if (cur_term->term_buf_count < TERM_BUF_SIZE && cur_term->reading) {
+    if (cur_term->term_buf_count < TERM_BUF_SIZE
+            && (cur_term->reading || cur_term->watchers)) {
         int i;
         for (i = cur_term->term_buf_count; i > cur_term->term_curpos; i --) {
             cur_term->term_buf[i] = cur_term->term_buf[i - 1];
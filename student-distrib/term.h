@@ -19,6 +19,12 @@ typedef enum {
     PARTIAL_FINISH,
 } esc_state_t;
 
+// Keyboard input on the caller's terminal, as reported by kstat
+typedef struct {
+    uint64_t key_tsc;       // TSC when the last key came in
+    uint32_t keys;
+} input_stats_t;
+
 typedef struct {
     char term_buf[TERM_BUF_SIZE_W_NL];
     uint8_t term_buf_count;
@@ -28,6 +34,12 @@ typedef struct {
     int8_t cur_x_store, cur_y_store;
     uint8_t attr;
     uint8_t reading;
+    // Tasks waiting for input in poll or an I/O ring; keys are taken while
+    // this or reading is set
+    uint8_t watchers;
+    // Tasks in term_read waiting for input
+    wait_queue_t read_wq;
+    input_stats_t input_stats;
 
     uint8_t *video_mem;
     uint8_t* video_buffer;
@@ -51,10 +63,13 @@ term_t *cur_term;
 
 void term_key_handler(key_t key);
 void init_term();
+void term_get_input_stats(uint8_t term_ind, input_stats_t *stats);
 int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file);
 int32_t term_read(int8_t* buf, uint32_t nbytes, FILE *file);
+void term_poll_wait(FILE *file, int32_t delta);
 int32_t term_open(const int8_t *filename, FILE *file);
 int32_t term_close();
+int32_t term_poll(FILE *file);
 
 int32_t printf(term_t *cur_term, int8_t *format, ...);
 void putc(uint8_t c, term_t *cur_term);
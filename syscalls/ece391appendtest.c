@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FNAME "appendtest.tmp"
+#define BUFSIZE 32
+
+/* Reports one check; returns 0 if it passed, 2 if not */
+static int32_t
+check (const char* name, int32_t ok)
+{
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, (uint8_t*)(ok ? ": PASS\n" : ": FAIL\n"));
+    return ok ? 0 : 2;
+}
+
+/* Reads the whole file into buf as a string; returns 0 on success */
+static int32_t
+read_back (uint8_t* buf)
+{
+    int32_t fd, cnt, total = 0;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)FNAME)))
+        return -1;
+    while (0 < (cnt = ece391_read (fd, buf + total, BUFSIZE - 1 - total)))
+        total += cnt;
+    ece391_close (fd);
+    buf[total] = '\0';
+    return cnt;
+}
+
+/* Writes a file, reopens it with FD_APPEND and writes more, then checks
+ * the second write landed after the first even after the descriptor was
+ * read from. A plain descriptor still writes from the start. "appendtest" */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t fd, fail = 0;
+
+    if (-1 == (fd = ece391_create ((uint8_t*)FNAME))
+            || 3 != ece391_write (fd, (uint8_t*)"abc", 3)) {
+        ece391_fdputs (1, (uint8_t*)"could not write " FNAME "\n");
+        return 3;
+    }
+    ece391_close (fd);
+
+    if (-1 == (fd = ece391_open_flags ((uint8_t*)FNAME, FD_APPEND))) {
+        ece391_fdputs (1, (uint8_t*)"open_flags failed\n");
+        return 3;
+    }
+    fail |= check ("getfl", FD_APPEND == ece391_fcntl (fd, FCNTL_GETFL, 0));
+    fail |= check ("append", 3 == ece391_write (fd, (uint8_t*)"def", 3));
+    fail |= check ("read_then_append", 1 == ece391_read (fd, buf, 1)
+                   && 3 == ece391_write (fd, (uint8_t*)"ghi", 3));
+    ece391_close (fd);
+    fail |= check ("contents", 0 == read_back (buf)
+                   && 0 == ece391_strcmp (buf, (uint8_t*)"abcdefghi"));
+
+    fd = ece391_open ((uint8_t*)FNAME);
+    ece391_write (fd, (uint8_t*)"X", 1);
+    ece391_close (fd);
+    fail |= check ("overwrite", 0 == read_back (buf)
+                   && 0 == ece391_strcmp (buf, (uint8_t*)"Xbcdefghi"));
+    return fail;
+}
@@ -5,19 +5,25 @@
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, map;
+    uint32_t length;
     uint8_t buf[1024];
 
-    if (0 != ece391_getargs (buf, 1024)) {
-        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
-	return 3;
-    }
-
-    if (-1 == (fd = ece391_open (buf))) {
+    /* With no file, copy standard input, such as the end of a pipe */
+    if (0 != ece391_getargs (buf, 1024))
+        fd = 0;
+    else if (-1 == (fd = ece391_open (buf))) {
         ece391_fdputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
 
+    /* Write the file straight out of its mapping when possible */
+    if (-1 != (map = ece391_mmap (fd, &length))) {
+        cnt = ece391_write (1, (void*)map, length);
+        ece391_munmap ((void*)map);
+        return (-1 == cnt) ? 3 : 0;
+    }
+
     while (0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
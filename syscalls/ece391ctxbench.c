@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define PAGE 4096
+/* Pages touched after every RTC tick; each one costs a TLB miss if a
+ * context switch flushed the user entries since the last pass */
+#define WSET_PAGES 64
+#define RUNS 256
+#define RTC_FREQ 32
+
+static uint8_t wset[WSET_PAGES * PAGE];
+
+/* Read one byte from every page of the working set and return the TSC
+ * cycles it took */
+static uint32_t
+touch_wset (void)
+{
+    volatile uint8_t sum = 0;
+    uint64_t start, end;
+    int32_t i;
+
+    start = ece391_rdtsc ();
+    for (i = 0; i < WSET_PAGES; i++)
+        sum += wset[i * PAGE];
+    end = ece391_rdtsc ();
+    return (uint32_t)(end - start);
+}
+
+/* Like pingpong, wakes up on every RTC tick; the scheduler switches
+ * between the terminals' tasks underneath it. Passes over the working set
+ * that follow a context switch are timed separately from the rest */
+int main ()
+{
+    switch_stats_t sw;
+    uint32_t prev_switches, cycles, i;
+    uint32_t mhz, steady = 0, steady_n = 0, after = 0, after_n = 0;
+    int32_t rtc_fd, freq = RTC_FREQ, garbage;
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    if (-1 == rtc_fd || -1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"could not open the RTC\n");
+        return 3;
+    }
+
+    /* Fault the working set in first */
+    for (i = 0; i < WSET_PAGES; i++)
+        wset[i * PAGE] = i;
+
+    if (-1 == ece391_kstat (KSTAT_SWITCH, &sw, sizeof (sw))) {
+        ece391_fdputs (1, (uint8_t*)"could not read switch stats\n");
+        return 3;
+    }
+    prev_switches = sw.switches;
+    touch_wset ();
+
+    for (i = 0; i < RUNS; i++) {
+        ece391_read (rtc_fd, &garbage, 4);
+        ece391_kstat (KSTAT_SWITCH, &sw, sizeof (sw));
+        cycles = touch_wset ();
+        if (sw.switches != prev_switches) {
+            after += cycles;
+            after_n++;
+        } else {
+            steady += cycles;
+            steady_n++;
+        }
+        prev_switches = sw.switches;
+    }
+    ece391_close (rtc_fd);
+
+    ece391_print_num ("TSC: ", mhz, " MHz\n");
+    ece391_print_num ("working set: ", WSET_PAGES, " pages\n");
+    if (steady_n)
+        ece391_print_num ("  no switch:    ", steady / steady_n, " cycles/pass\n");
+    if (after_n)
+        ece391_print_num ("  after switch: ", after / after_n, " cycles/pass\n");
+    ece391_print_num ("kernel switch path (", sw.switches, " switches)\n");
+    ece391_print_num ("  last: ", sw.last_cycles, " cycles\n");
+    ece391_print_num ("  min:  ", sw.min_cycles, " cycles\n");
+    ece391_print_num ("  max:  ", sw.max_cycles, " cycles\n");
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 64
+#define RUNS 8
+
+/* Runs a program a few times and reports how long execute takes to get
+ * it to its first output (as measured by the kernel) and to run it to
+ * completion. "execbench ls" by default; "execbench shell" gives the
+ * shell-to-prompt time, typing exit at each prompt */
+int main ()
+{
+    uint8_t cmd[SBUFSIZE];
+    exec_stats_t ex;
+    uint64_t start, end;
+    uint32_t mhz, i, total_us = 0, first_us = 0, pages;
+
+    if (0 != ece391_getargs (cmd, SBUFSIZE))
+        ece391_strcpy (cmd, (uint8_t*)"ls");
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+    if (-1 == ece391_kstat (KSTAT_EXEC, &ex, sizeof (ex))) {
+        ece391_fdputs (1, (uint8_t*)"could not read exec stats\n");
+        return 3;
+    }
+    pages = ex.image_pages;
+
+    for (i = 0; i < RUNS; i++) {
+        start = ece391_rdtsc ();
+        if (-1 == ece391_execute (cmd)) {
+            ece391_fdputs (1, (uint8_t*)"execute failed\n");
+            return 2;
+        }
+        end = ece391_rdtsc ();
+        total_us += ece391_tsc_to_us (start, end, mhz);
+
+        if (-1 == ece391_kstat (KSTAT_EXEC, &ex, sizeof (ex)))
+            return 3;
+        first_us += ex.last_cycles / mhz;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_fdputs (1, cmd);
+    ece391_print_num (": ", RUNS, " runs\n");
+    ece391_print_num ("  exec to first output: ", first_us / RUNS, " us avg\n");
+    ece391_print_num ("  exec to halt:         ", total_us / RUNS, " us avg\n");
+    ece391_print_num ("  image pages per run:  ", (ex.image_pages - pages) / RUNS, "\n");
+
+    return 0;
+}
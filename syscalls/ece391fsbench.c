@@ -0,0 +1,72 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 4096
+#define SBUFSIZE 64
+/* Keep reading the file until at least this many bytes went through */
+#define MIN_TOTAL (1024 * 1024)
+
+static uint8_t buf[BUFSIZE];
+
+/* Read the whole file over and over with reads of `chunk' bytes and
+ * return the throughput in tenths of MB/s, or -1 on failure */
+static int32_t
+run_one (const uint8_t* fname, int32_t chunk, uint32_t mhz)
+{
+    int32_t fd, cnt;
+    uint32_t total = 0, us;
+    uint64_t start, end;
+
+    start = ece391_rdtsc ();
+    while (total < MIN_TOTAL) {
+        if (-1 == (fd = ece391_open (fname)))
+            return -1;
+        while (0 != (cnt = ece391_read (fd, buf, chunk))) {
+            if (-1 == cnt)
+                return -1;
+            total += cnt;
+        }
+        ece391_close (fd);
+    }
+    end = ece391_rdtsc ();
+
+    us = ece391_tsc_to_us (start, end, mhz);
+    if (0 == us)
+        us = 1;
+    /* bytes per microsecond is MB/s */
+    return (total * 10) / us;
+}
+
+int main ()
+{
+    static const int32_t chunks[] = {64, 1024, BUFSIZE};
+    uint8_t fname[SBUFSIZE];
+    uint8_t num[SBUFSIZE];
+    uint32_t mhz, i;
+    int32_t rate;
+
+    if (0 != ece391_getargs (fname, SBUFSIZE))
+        ece391_strcpy (fname, (uint8_t*)"verylargetextwithverylongname.txt");
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"TSC: ");
+    ece391_fdputs (1, ece391_itoa (mhz, num, 10));
+    ece391_fdputs (1, (uint8_t*)" MHz\n");
+
+    for (i = 0; i < sizeof (chunks) / sizeof (chunks[0]); i++) {
+        if (-1 == (rate = run_one (fname, chunks[i], mhz))) {
+            ece391_fdputs (1, (uint8_t*)"file read failed\n");
+            return 2;
+        }
+        ece391_fdputs (1, (uint8_t*)"read size ");
+        ece391_fdputs (1, ece391_itoa (chunks[i], num, 10));
+        ece391_print_tenths (": ", rate, " MB/s\n");
+    }
+
+    return 0;
+}
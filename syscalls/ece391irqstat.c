@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 33
+#define DEFAULT_SECONDS 5
+/* The RTC's default rate, the lowest it runs at */
+#define RTC_FREQ 2
+
+static const char* irq_names[IRQ_NUM] = {
+    "timer", "keyboard", "cascade", 0, 0, 0, 0, 0, "rtc",
+    [16] = "tick ipi", [17] = "resched ipi", [18] = "apic timer"
+};
+
+/* Counts the interrupts taken on each line over a few seconds. Run it with
+ * the other terminals idle to see how often the machine is woken up when
+ * there is nothing to do. Also prints what an EOI costs on the interrupt
+ * controller in use; build the kernel with APIC_USE_8259 to compare.
+ * "irqstat [seconds]" */
+int main ()
+{
+    uint8_t args[SBUFSIZE];
+    uint32_t seconds = DEFAULT_SECONDS, i, ticks;
+    irq_stats_t before, after;
+    int32_t rtc_fd, garbage;
+
+    if (0 == ece391_getargs (args, SBUFSIZE)) {
+        if (args[0] < '1' || args[0] > '9' || args[1]) {
+            ece391_fdputs (1, (uint8_t*)"usage: irqstat [seconds]\n");
+            return 3;
+        }
+        seconds = args[0] - '0';
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open the rtc\n");
+        return 3;
+    }
+
+    // Line up with an RTC tick before starting
+    ece391_read (rtc_fd, &garbage, 4);
+    if (-1 == ece391_kstat (KSTAT_IRQ, &before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"could not read the interrupt counts\n");
+        return 3;
+    }
+    for (ticks = 0; ticks < seconds * RTC_FREQ; ticks++)
+        ece391_read (rtc_fd, &garbage, 4);
+    ece391_kstat (KSTAT_IRQ, &after, sizeof (after));
+    ece391_close (rtc_fd);
+
+    ece391_print_num ("interrupts per second over ", seconds, " s:\n");
+    for (i = 0; i < IRQ_NUM; i++) {
+        if (after.counts[i] == before.counts[i])
+            continue;
+        ece391_print_num ("irq ", i, " ");
+        if (irq_names[i])
+            ece391_fdputs (1, (uint8_t*)irq_names[i]);
+        ece391_print_num (": ", (after.counts[i] - before.counts[i]) / seconds, "\n");
+    }
+    if (after.eois != before.eois) {
+        ece391_fdputs (1, after.controller == IRQ_CONTROLLER_IOAPIC
+                ? (uint8_t*)"local apic eoi: " : (uint8_t*)"8259 eoi: ");
+        ece391_print_num ("", (uint32_t)(after.eoi_cycles - before.eoi_cycles)
+                / (after.eois - before.eois), " cycles each\n");
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 33
+
+/* Print "<label><value>\n" */
+static void
+print_stat (const char* label, uint32_t value)
+{
+    uint8_t num[SBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    page_cache_stats_t pc;
+    exec_stats_t ex;
+    frame_stats_t fr;
+    switch_stats_t sw;
+
+    if (-1 == ece391_kstat (KSTAT_PAGE_CACHE, &pc, sizeof (pc))) {
+        ece391_fdputs (1, (uint8_t*)"could not read page cache stats\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"page cache\n");
+    print_stat ("  hits:      ", pc.hits);
+    print_stat ("  misses:    ", pc.misses);
+    print_stat ("  evictions: ", pc.evictions);
+
+    if (-1 == ece391_kstat (KSTAT_EXEC, &ex, sizeof (ex))) {
+        ece391_fdputs (1, (uint8_t*)"could not read exec stats\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"exec (cycles to first output)\n");
+    print_stat ("  programs:    ", ex.execs);
+    print_stat ("  image pages: ", ex.image_pages);
+    print_stat ("  last:        ", ex.last_cycles);
+    print_stat ("  min:         ", ex.min_cycles);
+    print_stat ("  max:         ", ex.max_cycles);
+
+    if (-1 == ece391_kstat (KSTAT_FRAMES, &fr, sizeof (fr))) {
+        ece391_fdputs (1, (uint8_t*)"could not read frame stats\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"physical frames\n");
+    print_stat ("  total: ", fr.total);
+    print_stat ("  free:  ", fr.free);
+
+    if (-1 == ece391_kstat (KSTAT_SWITCH, &sw, sizeof (sw))) {
+        ece391_fdputs (1, (uint8_t*)"could not read switch stats\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"context switches (cycles)\n");
+    print_stat ("  switches: ", sw.switches);
+    print_stat ("  last:     ", sw.last_cycles);
+    print_stat ("  min:      ", sw.min_cycles);
+    print_stat ("  max:      ", sw.max_cycles);
+
+    return 0;
+}
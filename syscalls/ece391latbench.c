@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 33
+#define MAX_KEYS 32
+
+/* Echoes keys itself, with the terminal in canonical mode, and times each
+ * one from the keyboard interrupt until its echo has been written. Start a
+ * CPU hog such as "counter" on another terminal first; the latency it
+ * adds is how long the hog keeps the CPU once the key is in.
+ * "latbench [rr|fair|mlfq]"; stops after MAX_KEYS keys or at 'q' */
+int main ()
+{
+    uint8_t args[SBUFSIZE];
+    uint8_t c;
+    uint32_t mhz, n = 0, us, total = 0, min = 0xFFFFFFFF, max = 0;
+    uint64_t now;
+    input_stats_t input;
+
+    if (0 == ece391_getargs (args, SBUFSIZE)) {
+        if (0 == ece391_strcmp (args, (uint8_t*)"rr")) {
+            ece391_setsched (SCHED_RR);
+        } else if (0 == ece391_strcmp (args, (uint8_t*)"fair")) {
+            ece391_setsched (SCHED_FAIR);
+        } else if (0 == ece391_strcmp (args, (uint8_t*)"mlfq")) {
+            ece391_setsched (SCHED_MLFQ);
+        } else {
+            ece391_fdputs (1, (uint8_t*)"usage: latbench [rr|fair|mlfq]\n");
+            return 3;
+        }
+    }
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"type some keys, q to stop\n");
+    // No echo, and keys are handed over one at a time
+    ece391_fdputs (1, (uint8_t*)"\033[1s\033[2s");
+    while (n < MAX_KEYS && 1 == ece391_read (0, &c, 1) && 'q' != c) {
+        ece391_write (1, &c, 1);
+        now = ece391_rdtsc ();
+        if (-1 == ece391_kstat (KSTAT_INPUT, &input, sizeof (input)))
+            break;
+        us = ece391_tsc_to_us (input.key_tsc, now, mhz);
+        total += us;
+        if (us < min)
+            min = us;
+        if (us > max)
+            max = us;
+        n++;
+    }
+    ece391_fdputs (1, (uint8_t*)"\033[1S\033[2S\n");
+
+    if (0 == n) {
+        ece391_fdputs (1, (uint8_t*)"no keys timed\n");
+        return 0;
+    }
+    ece391_print_num ("keys: ", n, "\n");
+    ece391_print_num ("key to echo: min ", min, " us");
+    ece391_print_num (", avg ", total / n, " us");
+    ece391_print_num (", max ", max, " us\n");
+    return 0;
+}
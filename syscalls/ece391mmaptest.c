@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FNAME "mmaptest.tmp"
+#define DATA "mapped blocks must outlive a truncate\n"
+
+/* Reports one check; returns 0 if it passed, 2 if not */
+static int32_t
+check (const char* name, int32_t ok)
+{
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, (uint8_t*)(ok ? ": PASS\n" : ": FAIL\n"));
+    return ok ? 0 : 2;
+}
+
+/* Maps a file, then tries to truncate it by creating it again. The
+ * truncate must fail while the mapping lives, leave the mapped bytes
+ * alone, and work once the mapping is gone. "mmaptest" */
+int main ()
+{
+    int32_t fd, fd2, map, len, i, fail = 0;
+    uint32_t length;
+    uint8_t c;
+
+    len = ece391_strlen ((uint8_t*)DATA);
+    if (-1 == (fd = ece391_create ((uint8_t*)FNAME))
+            || len != ece391_write (fd, (uint8_t*)DATA, len)) {
+        ece391_fdputs (1, (uint8_t*)"could not write " FNAME "\n");
+        return 3;
+    }
+    if (-1 == (map = ece391_mmap (fd, &length))) {
+        ece391_fdputs (1, (uint8_t*)"mmap failed\n");
+        return 3;
+    }
+
+    fail |= check ("truncate_mapped", -1 == ece391_create ((uint8_t*)FNAME));
+    for (i = 0; i < len && ((uint8_t*)map)[i] == DATA[i]; i++);
+    fail |= check ("mapping_intact", length == len && i == len);
+
+    fail |= check ("munmap", 0 == ece391_munmap ((void*)map));
+    fd2 = ece391_create ((uint8_t*)FNAME);
+    fail |= check ("truncate_unmapped", -1 != fd2
+                   && 0 == ece391_read (fd2, &c, 1));
+
+    if (-1 != fd2)
+        ece391_close (fd2);
+    ece391_close (fd);
+    return fail;
+}
@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define RTC_FREQ 16
+#define LINE_MAX 128
+
+/* Counts RTC ticks and takes lines from the keyboard in one loop that
+ * never waits, with both descriptors non-blocking, and keeps busy in
+ * between. Each line typed reports the ticks and the idle passes so far.
+ * "q" quits. "nbdemo" */
+int main ()
+{
+    uint8_t line[LINE_MAX];
+    int32_t rtc_fd, freq = RTC_FREQ, garbage, cnt;
+    uint32_t ticks = 0, idle = 0;
+
+    if (-1 == (rtc_fd = ece391_open_flags ((uint8_t*)"rtc", FD_NONBLOCK))
+            || -1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"rtc failed\n");
+        return 2;
+    }
+    if (-1 == ece391_fcntl (0, FCNTL_SETFL, FD_NONBLOCK)) {
+        ece391_fdputs (1, (uint8_t*)"fcntl failed\n");
+        return 2;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"Type a line, or q to quit\n");
+    while (1) {
+        if (0 == ece391_read (rtc_fd, &garbage, 4)) {
+            ticks++;
+            continue;
+        }
+        cnt = ece391_read (0, line, LINE_MAX - 1);
+        if (WOULD_BLOCK == cnt) {
+            /* Nothing came in; this is where other work would go */
+            idle++;
+            continue;
+        }
+        if (0 >= cnt)
+            break;
+        line[cnt] = '\0';
+        if ('q' == line[0] && ('\n' == line[1] || '\0' == line[1]))
+            break;
+        ece391_print_num ("", ticks, " ticks, ");
+        ece391_print_num ("", idle, " idle passes\n");
+    }
+
+    ece391_fcntl (0, FCNTL_SETFL, 0);
+    ece391_close (rtc_fd);
+    return 0;
+}
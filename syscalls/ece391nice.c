@@ -0,0 +1,29 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+
+/* Runs a command with a lower priority under the MLFQ policy.
+ * "nice N command [args]", N from 0 to SCHED_NICE_MAX */
+int main ()
+{
+    uint8_t args[BUFSIZE];
+    int32_t status;
+
+    if (0 != ece391_getargs (args, BUFSIZE) || args[0] < '0'
+            || args[0] > '0' + SCHED_NICE_MAX || args[1] != ' ' || !args[2]) {
+        ece391_fdputs (1, (uint8_t*)"usage: nice N command [args]\n");
+        return 3;
+    }
+    if (-1 == ece391_nice (args[0] - '0')) {
+        ece391_fdputs (1, (uint8_t*)"nice failed\n");
+        return 3;
+    }
+    if (-1 == (status = ece391_execute (args + 2))) {
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+        return 3;
+    }
+    return status;
+}
@@ -0,0 +1,110 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CHUNK 1024
+#define BANDWIDTH_KB 4096
+#define ROUND_TRIPS 1000
+
+static uint8_t buf[CHUNK];
+
+/* A forked child writes BANDWIDTH_KB through a pipe in CHUNK writes and
+ * closes it; returns how long until the reader saw end of file, in us */
+static int32_t
+bandwidth (uint32_t mhz)
+{
+    int32_t fds[2], pid, cnt, i;
+    uint32_t total = 0;
+    uint64_t start;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    start = ece391_rdtsc ();
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+    if (0 == pid) {
+        ece391_close (fds[0]);
+        for (i = 0; i < BANDWIDTH_KB * 1024 / CHUNK; i++)
+            if (CHUNK != ece391_write (fds[1], buf, CHUNK))
+                break;
+        ece391_halt (0);
+    }
+
+    ece391_close (fds[1]);
+    while (0 < (cnt = ece391_read (fds[0], buf, CHUNK)))
+        total += cnt;
+    ece391_close (fds[0]);
+    if (total != BANDWIDTH_KB * 1024)
+        return -1;
+    return ece391_tsc_to_us (start, ece391_rdtsc (), mhz);
+}
+
+/* Bounces a byte between this task and a forked child over two pipes
+ * ROUND_TRIPS times; returns the average round trip in ns */
+static int32_t
+latency (uint32_t mhz)
+{
+    int32_t to_child[2], to_parent[2], pid, i;
+    uint8_t c = 'x';
+    uint64_t start;
+
+    if (-1 == ece391_pipe (to_child))
+        return -1;
+    if (-1 == ece391_pipe (to_parent))
+        return -1;
+    if (-1 == (pid = ece391_fork ()))
+        return -1;
+    if (0 == pid) {
+        /* Echo until the parent closes its end */
+        ece391_close (to_child[1]);
+        ece391_close (to_parent[0]);
+        while (1 == ece391_read (to_child[0], &c, 1))
+            ece391_write (to_parent[1], &c, 1);
+        ece391_halt (0);
+    }
+    ece391_close (to_child[0]);
+    ece391_close (to_parent[1]);
+
+    start = ece391_rdtsc ();
+    for (i = 0; i < ROUND_TRIPS; i++) {
+        if (1 != ece391_write (to_child[1], &c, 1)
+                || 1 != ece391_read (to_parent[0], &c, 1))
+            return -1;
+    }
+    i = ece391_tsc_to_us (start, ece391_rdtsc (), mhz);
+    ece391_close (to_child[1]);
+    ece391_close (to_parent[0]);
+    return i * 1000 / ROUND_TRIPS;
+}
+
+/* Measures pipe throughput between two tasks, then the round trip of a
+ * single byte each way. "pipebench" */
+int main ()
+{
+    uint32_t mhz;
+    int32_t us, ns;
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+
+    if (-1 == (us = bandwidth (mhz))) {
+        ece391_fdputs (1, (uint8_t*)"bandwidth test failed\n");
+        return 3;
+    }
+    ece391_print_num ("bandwidth: ", BANDWIDTH_KB, " KB");
+    ece391_print_num (" in ", us, " us");
+    if (0 != us)
+        ece391_print_num (", ", BANDWIDTH_KB * 1000 / 1024 * 1000 / us, " MB/s");
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    if (-1 == (ns = latency (mhz))) {
+        ece391_fdputs (1, (uint8_t*)"latency test failed\n");
+        return 3;
+    }
+    ece391_print_num ("round trip: ", ns, " ns");
+    ece391_print_num (", one way ", ns / 2, " ns\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SCREEN_WIDTH 80
+#define FISH_ROW 0
+#define FISH_LEN 3
+#define RTC_FREQ 16
+#define LINE_MAX 128
+
+/* Draws the fish at x on the top row, facing the way it swims */
+static void
+draw_fish (uint8_t* video, int32_t x, int32_t dir)
+{
+    const uint8_t* fish = (const uint8_t*)(dir > 0 ? "><>" : "<><");
+    uint8_t* row = video + FISH_ROW * SCREEN_WIDTH * 2;
+    int32_t i;
+
+    for (i = 0; i < SCREEN_WIDTH; i++)
+        row[i * 2] = ' ';
+    for (i = 0; i < FISH_LEN; i++)
+        row[(x + i) * 2] = fish[i];
+}
+
+/* The same as ringdemo, with the reads made in turn by this task: a fish
+ * swims along the top row on RTC ticks while lines typed at the keyboard
+ * are echoed back, and poll says which read won't block. "q" quits.
+ * "polldemo" */
+int main ()
+{
+    uint8_t* video;
+    uint8_t line[LINE_MAX];
+    uint8_t num[33];
+    int32_t rtc_fd, freq = RTC_FREQ, garbage, cnt;
+    int32_t x = 0, dir = 1;
+    uint32_t ticks = 0;
+    pollfd_t fds[2];
+
+    if (-1 == ece391_vidmap (&video)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 2;
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))
+            || -1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"rtc failed\n");
+        return 2;
+    }
+
+    fds[0].fd = rtc_fd;
+    fds[0].events = POLL_IN;
+    fds[1].fd = 0;
+    fds[1].events = POLL_IN;
+    ece391_fdputs (1, (uint8_t*)"Type a line, or q to quit\n");
+    while (1) {
+        if (-1 == ece391_poll (fds, 2, -1)) {
+            ece391_fdputs (1, (uint8_t*)"poll failed\n");
+            break;
+        }
+        if (fds[0].revents & POLL_IN) {
+            ece391_read (rtc_fd, &garbage, 4);
+            draw_fish (video, x, dir);
+            x += dir;
+            if (x == 0 || x == SCREEN_WIDTH - FISH_LEN)
+                dir = -dir;
+            ticks++;
+        }
+        if (fds[1].revents & POLL_IN) {
+            if (0 >= (cnt = ece391_read (0, line, LINE_MAX - 1)))
+                continue;
+            line[cnt] = '\0';
+            if ('q' == line[0] && ('\n' == line[1] || '\0' == line[1]))
+                break;
+            ece391_fdputs (1, (uint8_t*)"echo after ");
+            ece391_fdputs (1, ece391_itoa (ticks, num, 10));
+            ece391_fdputs (1, (uint8_t*)" ticks: ");
+            ece391_fdputs (1, line);
+        }
+    }
+
+    ece391_close (rtc_fd);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAX_TASKS 16
+
+static const char* state_names[] = { "run    ", "wait   ", "blocked" };
+
+/* Lists every task with the CPU time it has used since it started. pid 0 is
+ * the idle loop; a shell waiting for input should be blocked and its time
+ * should not grow between two runs */
+int main ()
+{
+    task_stat_t tasks[MAX_TASKS];
+    uint32_t mhz, n, i, total = 0;
+    uint32_t us[MAX_TASKS];
+    int32_t bytes;
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+    if (-1 == (bytes = ece391_kstat (KSTAT_TASKS, tasks, sizeof (tasks)))) {
+        ece391_fdputs (1, (uint8_t*)"could not read the task list\n");
+        return 3;
+    }
+    n = bytes / sizeof (task_stat_t);
+    for (i = 0; i < n; i++) {
+        us[i] = ece391_tsc_to_us (0, tasks[i].cpu_cycles, mhz);
+        total += us[i];
+    }
+
+    ece391_fdputs (1, (uint8_t*)"pid term state   ticks cpu\n");
+    for (i = 0; i < n; i++) {
+        ece391_print_num ("", tasks[i].pid, "   ");
+        if (0 == tasks[i].pid)
+            ece391_fdputs (1, (uint8_t*)"-    idle   ");
+        else {
+            ece391_print_num ("", tasks[i].term_ind, "    ");
+            ece391_fdputs (1, (uint8_t*)(tasks[i].state <= TASK_BLOCKED
+                    ? state_names[tasks[i].state] : "?      "));
+        }
+        ece391_print_num (" ", tasks[i].run_ticks, " ");
+        ece391_print_num ("", us[i] / 1000, " ms");
+        ece391_print_num (" (", total >= 100 ? us[i] / (total / 100) : 0, "%)\n");
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SCREEN_WIDTH 80
+#define FISH_ROW 0
+#define FISH_LEN 3
+#define RTC_FREQ 16
+#define LINE_MAX 128
+
+/* user_data of the two ops kept in flight */
+#define TAG_TICK 1
+#define TAG_KEY 2
+
+static io_ring_t* ring;
+static uint8_t line[LINE_MAX];
+
+/* Puts an op on the submission ring; ece391_io_enter takes it */
+static void
+submit (uint32_t opcode, int32_t fd, void* buf, uint32_t len, uint32_t tag)
+{
+    io_sqe_t* sqe = &ring->sqes[ring->sq_tail & IO_RING_MASK];
+
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->buf = (uint32_t)buf;
+    sqe->len = len;
+    sqe->user_data = tag;
+    ring->sq_tail++;
+}
+
+/* Draws the fish at x on the top row, facing the way it swims */
+static void
+draw_fish (uint8_t* video, int32_t x, int32_t dir)
+{
+    const uint8_t* fish = (const uint8_t*)(dir > 0 ? "><>" : "<><");
+    uint8_t* row = video + FISH_ROW * SCREEN_WIDTH * 2;
+    int32_t i;
+
+    for (i = 0; i < SCREEN_WIDTH; i++)
+        row[i * 2] = ' ';
+    for (i = 0; i < FISH_LEN; i++)
+        row[(x + i) * 2] = fish[i];
+}
+
+/* A fish swims along the top row on RTC ticks while lines typed at the
+ * keyboard are echoed back, both from one loop that waits on a single
+ * I/O ring instead of blocking in either read. "q" quits. "ringdemo" */
+int main ()
+{
+    uint8_t* video;
+    int32_t rtc_fd, freq = RTC_FREQ, garbage;
+    int32_t x = 0, dir = 1, to_submit, running = 1;
+    uint32_t ticks = 0;
+    uint8_t num[33];
+    io_cqe_t* cqe;
+
+    if (-1 == ece391_vidmap (&video)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 2;
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))
+            || -1 == ece391_write (rtc_fd, &freq, 4)) {
+        ece391_fdputs (1, (uint8_t*)"rtc failed\n");
+        return 2;
+    }
+    if (-1 == (int32_t)(ring = (io_ring_t*)ece391_io_setup ())) {
+        ece391_fdputs (1, (uint8_t*)"io_setup failed\n");
+        return 2;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"Type a line, or q to quit\n");
+    submit (IO_OP_READ, rtc_fd, &garbage, 4, TAG_TICK);
+    submit (IO_OP_READ, 0, line, LINE_MAX - 1, TAG_KEY);
+    to_submit = 2;
+
+    while (running) {
+        ece391_io_enter (to_submit, 1);
+        to_submit = 0;
+        while (ring->cq_head != ring->cq_tail) {
+            cqe = &ring->cqes[ring->cq_head & IO_RING_MASK];
+            if (TAG_TICK == cqe->user_data) {
+                draw_fish (video, x, dir);
+                x += dir;
+                if (x == 0 || x == SCREEN_WIDTH - FISH_LEN)
+                    dir = -dir;
+                ticks++;
+                submit (IO_OP_READ, rtc_fd, &garbage, 4, TAG_TICK);
+                to_submit++;
+            } else {
+                if (cqe->result > 0) {
+                    line[cqe->result] = '\0';
+                    if ('q' == line[0] && ('\n' == line[1] || '\0' == line[1])) {
+                        running = 0;
+                    } else {
+                        ece391_fdputs (1, (uint8_t*)"echo after ");
+                        ece391_fdputs (1, ece391_itoa (ticks, num, 10));
+                        ece391_fdputs (1, (uint8_t*)" ticks: ");
+                        ece391_fdputs (1, line);
+                    }
+                }
+                if (running) {
+                    submit (IO_OP_READ, 0, line, LINE_MAX - 1, TAG_KEY);
+                    to_submit++;
+                }
+            }
+            ring->cq_head++;
+        }
+    }
+
+    ece391_close (rtc_fd);
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 33
+#define MAX_WORKERS 8
+#define DEFAULT_WORKERS 4
+#define RUN_SECONDS 5
+/* Busy-loop steps per counted unit of work */
+#define UNIT_STEPS 1000
+#define RTC_FREQ 16
+/* RTC ticks to wait for the other workers to report */
+#define REPORT_WAIT (2 * RTC_FREQ)
+
+/* Per-worker result files; the last character is the worker's number */
+static uint8_t fname[] = "schedw0";
+
+/* Count units of CPU-bound work until the deadline */
+static uint32_t
+spin (uint64_t deadline)
+{
+    volatile uint32_t step;
+    uint32_t units = 0;
+
+    while (ece391_rdtsc () < deadline) {
+        for (step = 0; step < UNIT_STEPS; step++);
+        units++;
+    }
+    return units;
+}
+
+/* Read a worker's count back; 0 if it has not reported yet */
+static uint32_t
+read_result (uint32_t w)
+{
+    uint32_t units = 0;
+    int32_t fd;
+
+    fname[6] = '0' + w;
+    if (-1 == (fd = ece391_open (fname)))
+        return 0;
+    if (4 != ece391_read (fd, &units, 4))
+        units = 0;
+    ece391_close (fd);
+    return units;
+}
+
+/* Forks N CPU-bound workers (N - 1 children plus this task) that all spin
+ * for the same RUN_SECONDS. Every ready task should get the CPU, whatever
+ * its terminal, so the total is the machine's throughput and the spread
+ * between workers shows how fair the policy is. Run it for N up to the
+ * number of CPUs to see how throughput scales.
+ * "schedbench [N] [rr|fair|mlfq]" */
+int main ()
+{
+    uint8_t args[SBUFSIZE];
+    uint32_t mhz, n = DEFAULT_WORKERS, w = 0, i, units, total, min, max;
+    uint32_t results[MAX_WORKERS];
+    uint64_t deadline;
+    uint32_t waited;
+    int32_t fd, rtc_fd, freq = RTC_FREQ, garbage, pid;
+    uint8_t* policy = 0;
+    cpu_stats_t cpus;
+
+    if (0 == ece391_getargs (args, SBUFSIZE)) {
+        if (args[0] >= '1' && args[0] <= '0' + MAX_WORKERS) {
+            n = args[0] - '0';
+            policy = args[1] == ' ' ? args + 2 : 0;
+        } else {
+            policy = args;
+        }
+    }
+    if (policy) {
+        if (0 == ece391_strcmp (policy, (uint8_t*)"fair")) {
+            ece391_setsched (SCHED_FAIR);
+        } else if (0 == ece391_strcmp (policy, (uint8_t*)"rr")) {
+            ece391_setsched (SCHED_RR);
+        } else if (0 == ece391_strcmp (policy, (uint8_t*)"mlfq")) {
+            ece391_setsched (SCHED_MLFQ);
+        } else {
+            ece391_fdputs (1, (uint8_t*)"usage: schedbench [N] [rr|fair|mlfq]\n");
+            return 3;
+        }
+    }
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+    /* Leave nothing behind from an earlier run */
+    for (i = 0; i < n; i++) {
+        fname[6] = '0' + i;
+        if (-1 == (fd = ece391_create (fname))) {
+            ece391_fdputs (1, (uint8_t*)"could not create the result files\n");
+            return 3;
+        }
+        ece391_close (fd);
+    }
+
+    deadline = ece391_rdtsc () + (uint64_t)mhz * 1000000 * RUN_SECONDS;
+    for (i = 1; i < n; i++) {
+        if (-1 == (pid = ece391_fork ())) {
+            ece391_fdputs (1, (uint8_t*)"fork failed\n");
+            break;
+        }
+        if (0 == pid) {
+            w = i;
+            break;
+        }
+    }
+
+    units = spin (deadline);
+
+    if (0 != w) {
+        fname[6] = '0' + w;
+        if (-1 != (fd = ece391_open (fname))) {
+            ece391_write (fd, &units, 4);
+            ece391_close (fd);
+        }
+        return 0;
+    }
+
+    /* Worker 0 collects everyone's count */
+    results[0] = units;
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    if (-1 != rtc_fd)
+        ece391_write (rtc_fd, &freq, 4);
+    for (i = 1; i < n; i++) {
+        for (waited = 0; 0 == (results[i] = read_result (i))
+                && -1 != rtc_fd && waited < REPORT_WAIT; waited++)
+            ece391_read (rtc_fd, &garbage, 4);
+    }
+    if (-1 != rtc_fd)
+        ece391_close (rtc_fd);
+
+    total = 0;
+    min = max = results[0];
+    for (i = 0; i < n; i++) {
+        ece391_print_num ("worker ", i, ": ");
+        ece391_print_num ("", results[i], " units\n");
+        total += results[i];
+        if (results[i] < min)
+            min = results[i];
+        if (results[i] > max)
+            max = results[i];
+    }
+    ece391_print_num ("throughput: ", total / RUN_SECONDS, " units/s");
+    ece391_print_num (" (", UNIT_STEPS, " loop steps each)\n");
+    ece391_print_num ("fairness:   ", max ? (min * 100) / max : 0, "% (slowest / fastest)\n");
+    if (-1 != ece391_kstat (KSTAT_CPUS, &cpus, sizeof (cpus))) {
+        total = 0;
+        for (i = 0; i < cpus.cpus; i++)
+            total += cpus.steals[i];
+        ece391_print_num ("cpus:       ", cpus.cpus, "");
+        ece391_print_num (" (", total, " tasks stolen since boot)\n");
+    }
+    return 0;
+}
@@ -5,6 +5,66 @@
 
 #define BUFSIZE 1024
 
+/* Drops the spaces around s, in place */
+static uint8_t*
+trim (uint8_t* s)
+{
+    uint8_t* end;
+
+    while (' ' == *s)
+        s++;
+    end = s + ece391_strlen (s);
+    while (end > s && ' ' == end[-1])
+        end--;
+    *end = '\0';
+    return s;
+}
+
+/* Runs a command line and returns what execute does for its last stage.
+ * In "a | b", b runs here with its input from a pipe, like any other
+ * command. Nothing could wait for a second program, so a runs in a forked
+ * copy of the shell with its output into the pipe; "a" may itself hold
+ * more stages */
+static int32_t
+run (uint8_t* cmd)
+{
+    uint8_t* bar = 0;
+    uint8_t* p;
+    int32_t fds[2], saved, rval;
+
+    for (p = cmd; '\0' != *p; p++)
+        if ('|' == *p)
+            bar = p;
+    if (0 == bar)
+        return ece391_execute (trim (cmd));
+    *bar = '\0';
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    if (-1 == (rval = ece391_fork ())) {
+        ece391_close (fds[0]);
+        ece391_close (fds[1]);
+        return -1;
+    }
+    if (0 == rval) {
+        ece391_dup2 (fds[1], 1);
+        ece391_close (fds[0]);
+        ece391_close (fds[1]);
+        ece391_halt (run (cmd));
+    }
+
+    /* Closing our copies leaves b the only reader and a the only writer,
+     * so each sees the other finish */
+    saved = ece391_dup2 (0, -1);
+    ece391_dup2 (fds[0], 0);
+    ece391_close (fds[0]);
+    ece391_close (fds[1]);
+    rval = ece391_execute (trim (bar + 1));
+    ece391_dup2 (saved, 0);
+    ece391_close (saved);
+    return rval;
+}
+
 int main ()
 {
     int32_t cnt, rval;
@@ -24,7 +84,7 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	rval = run (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
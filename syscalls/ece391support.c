@@ -102,9 +102,126 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Print "<label><value><suffix>" on standard output */
+void ece391_print_num(const char* label, uint32_t value, const char* suffix)
+{
+    uint8_t num[33];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/* Print "<label><value / 10>.<value % 10><suffix>", for rates the
+ * benchmarks keep in tenths */
+void ece391_print_tenths(const char* label, uint32_t value, const char* suffix)
+{
+    uint8_t num[33];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value / 10, num, 10));
+    ece391_fdputs (1, (uint8_t*)".");
+    ece391_fdputs (1, ece391_itoa (value % 10, num, 10));
+    ece391_fdputs (1, (uint8_t*)suffix);
+}
+
+/* User-space allocator. Memory comes from the kernel a few pages at a time
+ * with sbrk and is carved up with a bump pointer. Freed blocks go on a free
+ * list per power of two size, from ARENA_MIN_SIZE to ARENA_MAX_SIZE, and
+ * are reused before the bump pointer moves; bigger blocks share one list,
+ * searched first fit. Only growing the arena enters the kernel. */
+#define ARENA_PAGE_SIZE 4096
+#define ARENA_GROW_PAGES 16
+#define ARENA_MIN_SHIFT 4
+#define ARENA_MIN_SIZE (1 << ARENA_MIN_SHIFT)
+#define ARENA_MAX_SIZE 2048
+#define ARENA_CLASSES 8
+#define ARENA_HDR_SIZE 8
+
+typedef struct arena_block {
+    uint32_t size;                  /* payload bytes */
+    struct arena_block* next;       /* next free block, while free */
+} arena_block_t;
+
+static arena_block_t* arena_free[ARENA_CLASSES];
+static arena_block_t* arena_large;
+static uint8_t* arena_cur;
+static uint8_t* arena_end;
+
+/* Make room for at least `bytes' more at the bump pointer */
+static int32_t arena_grow(uint32_t bytes)
+{
+    uint32_t npages = (bytes + ARENA_PAGE_SIZE - 1) / ARENA_PAGE_SIZE;
+    int32_t old_brk;
+
+    if (npages < ARENA_GROW_PAGES)
+        npages = ARENA_GROW_PAGES;
+    if (-1 == (old_brk = ece391_sbrk(npages)))
+        return -1;
+    /* Start over if someone else moved the break in between */
+    if ((uint8_t*)old_brk != arena_end)
+        arena_cur = (uint8_t*)old_brk;
+    arena_end = (uint8_t*)old_brk + npages * ARENA_PAGE_SIZE;
+    return 0;
+}
+
+void *ece391_alloc(uint32_t bytes)
+{
+    arena_block_t* blk;
+    arena_block_t** prev;
+    uint32_t size, c;
+
+    if (0 == bytes)
+        return 0;
+    if (bytes <= ARENA_MAX_SIZE) {
+        for (c = 0, size = ARENA_MIN_SIZE; size < bytes; c++, size <<= 1);
+        if (0 != (blk = arena_free[c])) {
+            arena_free[c] = blk->next;
+            return (uint8_t*)blk + ARENA_HDR_SIZE;
+        }
+    } else {
+        size = (bytes + ARENA_HDR_SIZE - 1) & ~(ARENA_HDR_SIZE - 1);
+        for (prev = &arena_large; 0 != (blk = *prev); prev = &blk->next) {
+            if (blk->size >= size) {
+                *prev = blk->next;
+                return (uint8_t*)blk + ARENA_HDR_SIZE;
+            }
+        }
+    }
+
+    if ((uint32_t)(arena_end - arena_cur) < ARENA_HDR_SIZE + size
+            && -1 == arena_grow(ARENA_HDR_SIZE + size))
+        return 0;
+    blk = (arena_block_t*)arena_cur;
+    blk->size = size;
+    arena_cur += ARENA_HDR_SIZE + size;
+    return (uint8_t*)blk + ARENA_HDR_SIZE;
+}
+
+void ece391_release(void *ptr)
+{
+    arena_block_t* blk;
+    uint32_t c;
+
+    if (0 == ptr)
+        return;
+    blk = (arena_block_t*)((uint8_t*)ptr - ARENA_HDR_SIZE);
+    if (blk->size > ARENA_MAX_SIZE) {
+        blk->next = arena_large;
+        arena_large = blk;
+        return;
+    }
+    for (c = 0; (ARENA_MIN_SIZE << c) < blk->size; c++);
+    blk->next = arena_free[c];
+    arena_free[c] = blk;
+}
+
 void *ece391_calloc(uint32_t bytes) {
-    uint8_t *ptr = ece391_malloc(bytes);
+    uint8_t *ptr = ece391_alloc(bytes);
     uint32_t i;
+    if (!ptr) {
+        return ptr;
+    }
     for (i = 0; i < bytes; i ++) {
         ptr[i] = 0;
     }
@@ -113,8 +230,125 @@ void *ece391_calloc(uint32_t bytes) {
 
 char *ece391_strdup(const char *str) {
     uint32_t len = ece391_strlen(str);
-    char *new_str = ece391_malloc(len + 1);
+    char *new_str = ece391_alloc(len + 1);
     ece391_strcpy((uint8_t *) new_str, (const uint8_t *) str);
     new_str[len] = 0;
     return new_str;
 }
+
+/* Create (or truncate) a file by writing its name to the directory, then
+ * open it. Returns the new descriptor or -1 on failure. */
+int32_t ece391_create(const uint8_t* fname)
+{
+    int32_t dir_fd, ret;
+
+    if (-1 == (dir_fd = ece391_open((uint8_t*)".")))
+        return -1;
+    ret = ece391_write(dir_fd, fname, ece391_strlen(fname));
+    ece391_close(dir_fd);
+    if (-1 == ret)
+        return -1;
+    return ece391_open(fname);
+}
+
+/* Read the processor's time-stamp counter */
+uint64_t ece391_rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Estimate the time-stamp counter rate in MHz by counting cycles across
+ * a quarter second of RTC ticks. Returns 0 if the RTC can't be used. */
+uint32_t ece391_tsc_mhz(void)
+{
+    int32_t rtc_fd, freq = 64, garbage, i;
+    uint64_t start, end;
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")))
+        return 0;
+    if (-1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_close(rtc_fd);
+        return 0;
+    }
+
+    /* Line up with a tick edge first */
+    ece391_read(rtc_fd, &garbage, 4);
+    start = ece391_rdtsc();
+    for (i = 0; i < freq / 4; i++)
+        ece391_read(rtc_fd, &garbage, 4);
+    end = ece391_rdtsc();
+    ece391_close(rtc_fd);
+
+    return (uint32_t)(end - start) / 250000;
+}
+
+/* Convert a time-stamp counter interval to microseconds. There is no
+ * 64-bit division available, so large intervals lose their low bits. */
+uint32_t ece391_tsc_to_us(uint64_t start, uint64_t end, uint32_t mhz)
+{
+    uint64_t delta = end - start;
+    uint32_t shift = 0;
+
+    if (0 == mhz)
+        return 0;
+    while (delta >> 32) {
+        delta >>= 1;
+        shift++;
+    }
+    return ((uint32_t)delta / mhz) << shift;
+}
+
+/* The task that reads the per-CPU page is always the one it describes: the
+ * kernel rewrites it on every switch before the task gets the CPU */
+int32_t ece391_getpid(void)
+{
+    return ((volatile ece391_kdata_cpu_t*)ECE391_KDATA_CPU_ADDR)->pid;
+}
+
+int32_t ece391_getterm(void)
+{
+    return ((volatile ece391_kdata_cpu_t*)ECE391_KDATA_CPU_ADDR)->term_ind;
+}
+
+/* May be stale by the time it is used, if the task has moved since */
+int32_t ece391_getcpu(void)
+{
+    return ((volatile ece391_kdata_cpu_t*)ECE391_KDATA_CPU_ADDR)->cpu;
+}
+
+/* RTC interrupts since boot; the rate they come at right now goes in freq
+ * unless it is NULL */
+uint32_t ece391_rtc_ticks(uint32_t* freq)
+{
+    volatile ece391_kdata_t* kd = (volatile ece391_kdata_t*)ECE391_KDATA_ADDR;
+    uint32_t seq, ticks, rate;
+
+    do {
+        seq = kd->seq;
+        ticks = kd->rtc_ticks;
+        rate = kd->rtc_freq;
+    } while ((seq & 1) || seq != kd->seq);
+    if (freq)
+        *freq = rate;
+    return ticks;
+}
+
+/* Microseconds since boot, from the kernel's last clock update plus the
+ * TSC cycles since then. Retries if the kernel updated it meanwhile */
+uint64_t ece391_uptime_us(void)
+{
+    volatile ece391_kdata_t* kd = (volatile ece391_kdata_t*)ECE391_KDATA_ADDR;
+    uint32_t seq, mult, frac;
+    uint64_t base, tsc;
+
+    do {
+        seq = kd->seq;
+        base = kd->clock_us;
+        tsc = kd->clock_tsc;
+        frac = kd->clock_frac;
+        mult = kd->us_mult;
+    } while ((seq & 1) || seq != kd->seq);
+    return base + (((ece391_rdtsc() - tsc) * mult + frac) >> 32);
+}
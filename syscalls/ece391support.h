@@ -8,8 +8,44 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern void ece391_print_num(const char* label, uint32_t value, const char* suffix);
+extern void ece391_print_tenths(const char* label, uint32_t value, const char* suffix);
+extern void *ece391_alloc(uint32_t bytes);
+extern void ece391_release(void *ptr);
 extern void *ece391_calloc(uint32_t bytes);
 extern char *ece391_strdup(const char *str);
+extern int32_t ece391_create(const uint8_t* fname);
+extern uint64_t ece391_rdtsc(void);
+extern uint32_t ece391_tsc_mhz(void);
+extern uint32_t ece391_tsc_to_us(uint64_t start, uint64_t end, uint32_t mhz);
+
+/* Read-only kernel data mapped into every task after video memory; read
+ * through the functions below, which never trap. Must match kdata.h */
+#define ECE391_KDATA_ADDR       0x8801000
+#define ECE391_KDATA_CPU_ADDR   0x8802000
+
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t tsc_khz;
+    uint32_t us_mult;
+    uint32_t clock_frac;
+    uint64_t clock_us;
+    uint64_t clock_tsc;
+    uint32_t rtc_ticks;
+    uint32_t rtc_freq;
+} ece391_kdata_t;
+
+typedef struct {
+    uint32_t pid;
+    uint32_t term_ind;
+    uint32_t cpu;
+} ece391_kdata_cpu_t;
+
+extern int32_t ece391_getpid(void);
+extern int32_t ece391_getterm(void);
+extern int32_t ece391_getcpu(void);
+extern uint32_t ece391_rtc_ticks(uint32_t* freq);
+extern uint64_t ece391_uptime_us(void);
 
 #endif /* ECE391SUPPORT_H */
 
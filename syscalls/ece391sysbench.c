@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define ITERATIONS 10000
+#define BATCH_SIZE 64
+#define BATCH_ROUNDS 200
+
+/* Times a call that does nothing: kstat with no buffer returns -1 as soon
+ * as it is dispatched, so what is left is entering and leaving the
+ * kernel. Prints the fastest single call and the average over a loop */
+static void
+time_null_call (const char* label, int32_t (*call)(int32_t, void*, int32_t))
+{
+    uint64_t start;
+    uint32_t i, cycles, min = 0xFFFFFFFF;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        start = ece391_rdtsc ();
+        call (KSTAT_IRQ, 0, 0);
+        cycles = (uint32_t)(ece391_rdtsc () - start);
+        if (cycles < min)
+            min = cycles;
+    }
+    start = ece391_rdtsc ();
+    for (i = 0; i < ITERATIONS; i++)
+        call (KSTAT_IRQ, 0, 0);
+    cycles = (uint32_t)(ece391_rdtsc () - start);
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_print_num (": min ", min, " cycles");
+    ece391_print_num (", avg ", cycles / ITERATIONS, " cycles\n");
+}
+
+/* Times BATCH_SIZE small kstat calls made one trap each against the same
+ * calls in one batch. Prints the fastest round of each */
+static void
+time_batch (void)
+{
+    static syscall_req_t reqs[BATCH_SIZE];
+    frame_stats_t stats;
+    uint64_t start;
+    uint32_t i, round, cycles, min_single = 0xFFFFFFFF, min_batch = 0xFFFFFFFF;
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        reqs[i].num = SYS_KSTAT;
+        reqs[i].args[0] = KSTAT_FRAMES;
+        reqs[i].args[1] = (int32_t)&stats;
+        reqs[i].args[2] = sizeof (stats);
+    }
+
+    for (round = 0; round < BATCH_ROUNDS; round++) {
+        start = ece391_rdtsc ();
+        for (i = 0; i < BATCH_SIZE; i++)
+            ece391_kstat (KSTAT_FRAMES, &stats, sizeof (stats));
+        cycles = (uint32_t)(ece391_rdtsc () - start);
+        if (cycles < min_single)
+            min_single = cycles;
+
+        start = ece391_rdtsc ();
+        if (BATCH_SIZE != ece391_batch (reqs, BATCH_SIZE, BATCH_STOP_ON_ERROR)) {
+            ece391_fdputs (1, (uint8_t*)"batch failed\n");
+            return;
+        }
+        cycles = (uint32_t)(ece391_rdtsc () - start);
+        if (cycles < min_batch)
+            min_batch = cycles;
+    }
+
+    ece391_print_num ("64 traps: ", min_single, " cycles");
+    ece391_print_num (", 1 batch: ", min_batch, " cycles\n");
+}
+
+/* Null system call latency through INT $0x80 and through SYSENTER, then
+ * the cost of BATCH_SIZE calls made separately and batched. "sysbench" */
+int main ()
+{
+    time_null_call ("int 0x80", ece391_kstat);
+    time_null_call ("sysenter", ece391_fast_kstat);
+    time_batch ();
+    return 0;
+}
@@ -23,6 +23,113 @@ extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 extern void *ece391_malloc(uint32_t);
 extern int32_t ece391_free(void *);
+extern int32_t ece391_kstat(int32_t type, void* buf, int32_t nbytes);
+/* Returns the address of a read-only mapping of the file, -1 on failure */
+extern int32_t ece391_mmap(int32_t fd, uint32_t* length);
+extern int32_t ece391_munmap(void* addr);
+/* Returns the child's pid in the parent and 0 in the child, -1 on failure */
+extern int32_t ece391_fork(void);
+/* Grows (or shrinks) the heap by whole pages; returns the old break, -1 on
+ * failure */
+extern int32_t ece391_sbrk(int32_t npages);
+/* Picks the scheduling policy; returns the previous one, -1 on failure */
+extern int32_t ece391_setsched(int32_t policy);
+/* Sets the base priority, 0 (highest) to SCHED_NICE_MAX, kept by programs
+ * the task executes; returns the previous one, -1 on failure */
+extern int32_t ece391_nice(int32_t nice);
+/* Runs count calls for one trap, each result in its entry; halt, sigreturn,
+ * fork and batch fail. Returns the number run, -1 on failure */
+typedef struct {
+	int32_t num;		/* SYS_* from ece391sysnum.h */
+	int32_t args[3];
+	int32_t result;
+} syscall_req_t;
+#define BATCH_STOP_ON_ERROR 0x1
+extern int32_t ece391_batch(syscall_req_t* reqs, int32_t count, int32_t flags);
+
+/* Asynchronous I/O: fill in io_sqe_t entries at sq_tail, move sq_tail on,
+ * and call ece391_io_enter, which takes up to to_submit of them and waits
+ * until min_complete io_cqe_t entries are waiting past cq_head. Indexes
+ * only count up; entries are at index & IO_RING_MASK. A read of an RTC
+ * descriptor completes on its next tick. Ops on the same descriptor
+ * complete in order */
+#define IO_RING_ENTRIES 64
+#define IO_RING_MASK (IO_RING_ENTRIES - 1)
+enum io_ops {
+	IO_OP_READ = 0,
+	IO_OP_WRITE = 1
+};
+
+typedef struct {
+	uint32_t opcode;
+	int32_t fd;
+	uint32_t buf;
+	uint32_t len;
+	uint32_t user_data;	/* handed back in the completion */
+} io_sqe_t;
+
+typedef struct {
+	uint32_t user_data;
+	int32_t result;		/* what read or write would have returned */
+} io_cqe_t;
+
+typedef struct {
+	volatile uint32_t sq_head;	/* moved by the kernel */
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;	/* moved by the kernel */
+	io_sqe_t sqes[IO_RING_ENTRIES];
+	io_cqe_t cqes[IO_RING_ENTRIES];
+} io_ring_t;
+
+/* Returns the address of the caller's ring, -1 on failure */
+extern int32_t ece391_io_setup(void);
+/* Returns the number of submissions taken, -1 on failure */
+extern int32_t ece391_io_enter(int32_t to_submit, int32_t min_complete);
+/* Opens a pipe: fds[0] reads what fds[1] writes. A read waits for data and
+ * returns 0 once every write end is closed; a write waits for room and
+ * fails once every read end is. Returns 0, -1 on failure */
+extern int32_t ece391_pipe(int32_t fds[2]);
+/* Makes newfd (closed first if open) refer to what oldfd does; -1 picks the
+ * lowest free descriptor from 2. Programs executed get the caller's 0 and
+ * 1. Returns the new descriptor, -1 on failure */
+extern int32_t ece391_dup2(int32_t oldfd, int32_t newfd);
+/* Waits until a read (POLL_IN) or write (POLL_OUT) on any of up to
+ * POLL_MAX_FDS descriptors would not block, and sets revents for each;
+ * POLL_NVAL means the descriptor isn't open. A timeout of 0 only checks,
+ * a negative one waits; there are no others. Returns the number of
+ * entries with revents set, -1 on failure */
+#define POLL_IN 0x1
+#define POLL_OUT 0x2
+#define POLL_NVAL 0x4
+#define POLL_MAX_FDS 8
+typedef struct {
+	int32_t fd;		/* skipped if negative */
+	int16_t events;
+	int16_t revents;
+} pollfd_t;
+extern int32_t ece391_poll(pollfd_t* fds, int32_t nfds, int32_t timeout);
+/* Descriptor flags. Reads and writes on an FD_NONBLOCK descriptor that
+ * would wait return WOULD_BLOCK instead; a write into a pipe with room for
+ * only part of the data returns how much went in. Programs executed get
+ * blocking 0 and 1 */
+#define FD_NONBLOCK 0x1
+/* Every write to a regular file opened with FD_APPEND goes to its end */
+#define FD_APPEND 0x2
+#define WOULD_BLOCK (-2)
+/* open, with the flags set from the start */
+extern int32_t ece391_open_flags(const uint8_t* filename, int32_t flags);
+/* FCNTL_GETFL returns the flags; FCNTL_SETFL replaces them with arg and
+ * returns 0; FCNTL_ISTERM returns 1 for a terminal, 0 for anything else,
+ * such as a pipe. -1 on failure */
+#define FCNTL_GETFL 0
+#define FCNTL_SETFL 1
+#define FCNTL_ISTERM 2
+extern int32_t ece391_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+/* read, write and kstat entered with SYSENTER instead of INT $0x80 */
+extern int32_t ece391_fast_read (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_fast_write (int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t ece391_fast_kstat(int32_t type, void* buf, int32_t nbytes);
 
 enum signums {
 	DIV_ZERO = 0,
@@ -33,5 +140,112 @@ enum signums {
 	NUM_SIGNALS
 };
 
+/* Scheduling policies for ece391_setsched */
+enum sched_policies {
+	SCHED_RR = 0,
+	SCHED_FAIR = 1,
+	SCHED_MLFQ = 2
+};
+
+#define SCHED_NICE_MAX 3
+
+/* Statistics types for ece391_kstat */
+enum kstat_types {
+	KSTAT_PAGE_CACHE = 0,
+	KSTAT_EXEC = 1,
+	KSTAT_FRAMES = 2,
+	KSTAT_SWITCH = 3,
+	KSTAT_MALLOC = 4,
+	KSTAT_TASKS = 5,
+	KSTAT_INPUT = 6,
+	KSTAT_IRQ = 7,
+	KSTAT_CPUS = 8
+};
+
+typedef struct {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+} page_cache_stats_t;
+
+/* Latencies are TSC cycles from the start of execute to the program's
+ * first write to the terminal */
+typedef struct {
+	uint32_t execs;
+	uint32_t image_pages;
+	uint32_t last_cycles;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+} exec_stats_t;
+
+/* Physical 4 KB frames */
+typedef struct {
+	uint32_t total;
+	uint32_t free;
+} frame_stats_t;
+
+/* TSC cycles the scheduler spends switching tasks */
+typedef struct {
+	uint32_t switches;
+	uint32_t last_cycles;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+} switch_stats_t;
+
+/* The calling program's malloc heap; sizes are in bytes */
+typedef struct {
+	uint32_t heap_size;
+	uint32_t free_bytes;
+	uint32_t largest_free;
+	uint32_t used_blocks;
+	uint32_t free_blocks;
+} malloc_stats_t;
+
+/* KSTAT_TASKS fills an array of these, one per task; pid 0 is the idle
+ * loop. The kstat return value is the number of bytes filled in */
+enum task_states {
+	TASK_RUNNABLE = 0,
+	TASK_WAITING = 1,	/* in execute until its child halts */
+	TASK_BLOCKED = 2	/* asleep in a read */
+};
+
+typedef struct {
+	uint32_t pid;
+	uint32_t term_ind;
+	uint32_t state;
+	uint32_t run_ticks;
+	uint64_t cpu_cycles;
+} task_stat_t;
+
+/* KSTAT_INPUT: keyboard input on the caller's terminal */
+typedef struct {
+	uint64_t key_tsc;	/* when the last key came in */
+	uint32_t keys;
+} input_stats_t;
+
+/* KSTAT_IRQ: interrupts taken on each ISA line since boot, then the tick
+ * and reschedule IPIs and the local APIC timers, added up over the CPUs,
+ * and the TSC cycles spent acknowledging them */
+#define IRQ_NUM 19
+enum irq_controllers {
+	IRQ_CONTROLLER_8259 = 0,
+	IRQ_CONTROLLER_IOAPIC = 1
+};
+
+typedef struct {
+	uint32_t counts[IRQ_NUM];
+	uint32_t controller;
+	uint32_t eois;
+	uint64_t eoi_cycles;
+} irq_stats_t;
+
+/* KSTAT_CPUS: the CPUs that are up */
+#define SMP_MAX_CPUS 4
+typedef struct {
+	uint32_t cpus;
+	uint32_t steals[SMP_MAX_CPUS];	/* tasks taken off other CPUs' queues */
+	uint64_t idle_cycles[SMP_MAX_CPUS];
+} cpu_stats_t;
+
 #endif /* ECE391SYSCALL_H */
 
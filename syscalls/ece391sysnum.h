@@ -13,5 +13,20 @@
 #define SYS_SIGRETURN  10
 #define SYS_MALLOC  11
 #define SYS_FREE  12
+#define SYS_KSTAT  13
+#define SYS_MMAP  14
+#define SYS_MUNMAP  15
+#define SYS_FORK  16
+#define SYS_SBRK  17
+#define SYS_SETSCHED  18
+#define SYS_NICE  19
+#define SYS_BATCH  20
+#define SYS_IO_SETUP  21
+#define SYS_IO_ENTER  22
+#define SYS_PIPE  23
+#define SYS_DUP2  24
+#define SYS_POLL  25
+#define SYS_FCNTL  26
+#define SYS_OPEN_FLAGS  27
 
 #endif /* ECE391SYSNUM_H */
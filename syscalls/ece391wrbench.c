@@ -0,0 +1,77 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 4096
+#define SBUFSIZE 33
+#define SMALL_WRITE 64
+#define SMALL_TOTAL (256 * 1024)
+#define LARGE_TOTAL (1024 * 1024)
+
+static uint8_t buf[BUFSIZE];
+
+/* Write `total' bytes into a freshly truncated file with writes of
+ * `chunk' bytes; return the throughput in tenths of MB/s, or -1 */
+static int32_t
+run_one (const uint8_t* fname, int32_t chunk, uint32_t total, uint32_t mhz)
+{
+    int32_t fd;
+    uint32_t done = 0, us;
+    uint64_t start, end;
+
+    if (-1 == (fd = ece391_create (fname)))
+        return -1;
+
+    start = ece391_rdtsc ();
+    while (done < total) {
+        if (chunk != ece391_write (fd, buf, chunk)) {
+            ece391_close (fd);
+            return -1;
+        }
+        done += chunk;
+    }
+    end = ece391_rdtsc ();
+    ece391_close (fd);
+
+    us = ece391_tsc_to_us (start, end, mhz);
+    if (0 == us)
+        us = 1;
+    return (done * 10) / us;
+}
+
+int main ()
+{
+    const uint8_t* fname = (uint8_t*)"wrbench.tmp";
+    uint8_t num[SBUFSIZE];
+    uint32_t mhz, i;
+    int32_t rate;
+
+    for (i = 0; i < BUFSIZE; i++)
+        buf[i] = 'a' + (i % 26);
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        ece391_fdputs (1, (uint8_t*)"could not calibrate the TSC\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"TSC: ");
+    ece391_fdputs (1, ece391_itoa (mhz, num, 10));
+    ece391_fdputs (1, (uint8_t*)" MHz\n");
+
+    if (-1 == (rate = run_one (fname, SMALL_WRITE, SMALL_TOTAL, mhz))) {
+        ece391_fdputs (1, (uint8_t*)"small writes failed\n");
+        return 2;
+    }
+    ece391_print_tenths ("64 B writes:  ", rate, " MB/s\n");
+
+    if (-1 == (rate = run_one (fname, BUFSIZE, LARGE_TOTAL, mhz))) {
+        ece391_fdputs (1, (uint8_t*)"large writes failed\n");
+        return 2;
+    }
+    ece391_print_tenths ("4 KB writes:  ", rate, " MB/s\n");
+
+    /* Leave an empty file behind */
+    if (-1 != (i = ece391_create (fname)))
+        ece391_close (i);
+    return 0;
+}
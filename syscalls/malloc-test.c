@@ -0,0 +1,201 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "printf.h"
+
+#define SLOTS 512
+#define FIXED_SIZE 32
+#define FIXED_ROUNDS 20
+#define MIXED_OPS 20000
+
+static uint8_t* slots[SLOTS];
+static uint32_t sizes[SLOTS];
+static uint32_t seed = 391;
+
+/* Small LCG so every run does the same sequence of calls */
+static uint32_t
+next_rand (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/* Mostly small requests with the odd large one */
+static uint32_t
+random_size (void)
+{
+    if (0 == next_rand () % 16)
+        return 1024 + next_rand () % 4096;
+    return 1 + next_rand () % 256;
+}
+
+/* Fill a block with a byte derived from its slot, so that overlapping
+ * blocks show up when they are checked */
+static void
+fill (uint32_t i)
+{
+    uint32_t j;
+    for (j = 0; j < sizes[i]; j++)
+        slots[i][j] = (uint8_t)(i + j);
+}
+
+static int32_t
+check (uint32_t i)
+{
+    uint32_t j;
+    for (j = 0; j < sizes[i]; j++)
+        if (slots[i][j] != (uint8_t)(i + j))
+            return -1;
+    return 0;
+}
+
+static void
+print_rate (const char* label, uint32_t ops, uint64_t start, uint64_t end, uint32_t mhz)
+{
+    uint32_t us = ece391_tsc_to_us (start, end, mhz);
+    if (0 == us)
+        us = 1;
+    printf ("%s%u ops in %u us, %u cycles/op\n", label, ops, us,
+            (uint32_t)(end - start) / ops);
+}
+
+/* The two allocators being compared: every call a trap into the kernel's
+ * heap, or the sbrk-backed arena in ece391support that rarely traps */
+static void*
+kernel_alloc (uint32_t bytes)
+{
+    return ece391_malloc (bytes);
+}
+
+static void
+kernel_release (void* ptr)
+{
+    ece391_free (ptr);
+}
+
+/* Allocate and free SLOTS same-size blocks FIXED_ROUNDS times; returns the
+ * number of calls made */
+static uint32_t
+run_fixed (void* (*alloc) (uint32_t), void (*release) (void*))
+{
+    uint32_t i, r;
+
+    for (r = 0; r < FIXED_ROUNDS; r++) {
+        for (i = 0; i < SLOTS; i++)
+            slots[i] = alloc (FIXED_SIZE);
+        for (i = 0; i < SLOTS; i++) {
+            release (slots[i]);
+            slots[i] = 0;
+        }
+    }
+    return 2 * SLOTS * FIXED_ROUNDS;
+}
+
+/* Random sizes, random slot to allocate or free; returns the number of
+ * allocations that failed */
+static uint32_t
+run_mixed (void* (*alloc) (uint32_t), void (*release) (void*))
+{
+    uint32_t i, ops, failed = 0;
+
+    for (ops = 0; ops < MIXED_OPS; ops++) {
+        i = next_rand () % SLOTS;
+        if (slots[i]) {
+            release (slots[i]);
+            slots[i] = 0;
+        } else {
+            sizes[i] = random_size ();
+            if (0 == (slots[i] = alloc (sizes[i])))
+                failed++;
+        }
+    }
+    return failed;
+}
+
+static void
+print_heap (const char* label)
+{
+    malloc_stats_t st;
+    uint32_t free_payload, frag;
+
+    if (-1 == ece391_kstat (KSTAT_MALLOC, &st, sizeof (st))) {
+        printf ("could not read heap stats\n");
+        return;
+    }
+    /* External fragmentation: the share of free memory that the largest
+     * request which would succeed cannot use */
+    free_payload = st.free_bytes - 8 * st.free_blocks;
+    frag = free_payload ? 100 - (st.largest_free * 100) / free_payload : 0;
+    printf ("%sused %u, free %u blocks / %u bytes, largest %u, fragmentation %u%%\n",
+            label, st.used_blocks, st.free_blocks, st.free_bytes,
+            st.largest_free, frag);
+}
+
+int main ()
+{
+    uint32_t mhz, i, ops, failed;
+    uint64_t start, end;
+
+    if (0 == (mhz = ece391_tsc_mhz ())) {
+        printf ("could not calibrate the TSC\n");
+        return 3;
+    }
+    printf ("TSC: %u MHz\n", mhz);
+
+    /* Same-size churn: always served from the head of one list */
+    start = ece391_rdtsc ();
+    ops = run_fixed (kernel_alloc, kernel_release);
+    end = ece391_rdtsc ();
+    print_rate ("syscall, fixed 32 B:  ", ops, start, end, mhz);
+
+    start = ece391_rdtsc ();
+    ops = run_fixed (ece391_alloc, ece391_release);
+    end = ece391_rdtsc ();
+    print_rate ("arena, fixed 32 B:    ", ops, start, end, mhz);
+
+    /* The arena gets the same sequence of calls; its slots are emptied
+     * again before the kernel heap's run */
+    seed = 391;
+    start = ece391_rdtsc ();
+    failed = run_mixed (ece391_alloc, ece391_release);
+    end = ece391_rdtsc ();
+    print_rate ("arena, mixed sizes:   ", MIXED_OPS, start, end, mhz);
+    if (failed)
+        printf ("  %u requests failed\n", failed);
+    for (i = 0; i < SLOTS; i++) {
+        ece391_release (slots[i]);
+        slots[i] = 0;
+    }
+
+    seed = 391;
+    start = ece391_rdtsc ();
+    failed = run_mixed (kernel_alloc, kernel_release);
+    end = ece391_rdtsc ();
+    print_rate ("syscall, mixed sizes: ", MIXED_OPS, start, end, mhz);
+    if (failed)
+        printf ("  %u requests failed\n", failed);
+    print_heap ("  after churn: ");
+
+    /* Nothing handed out may overlap */
+    for (i = 0; i < SLOTS; i++)
+        if (slots[i])
+            fill (i);
+    for (i = 0; i < SLOTS; i++) {
+        if (slots[i] && -1 == check (i)) {
+            printf ("block %u was overwritten\n", i);
+            return 2;
+        }
+    }
+
+    /* Freeing everything has to merge the heap back into one block */
+    for (i = 0; i < SLOTS; i++) {
+        if (slots[i] && -1 == ece391_free (slots[i])) {
+            printf ("free of block %u failed\n", i);
+            return 2;
+        }
+        slots[i] = 0;
+    }
+    print_heap ("  all freed:   ");
+    return 0;
+}